@@ -0,0 +1,24 @@
+// ERTS stand-ins for the native benchmark
+//
+// The benchmark links the NIF source into a standalone binary with no VM
+// behind it. Every function erl_nif.h declares is defined here from the
+// header's own API list, so the binary links without any unresolved symbol,
+// and a benchmark that reaches into ERTS stops with the function's name
+// instead of jumping to address zero.
+
+#include <erl_nif.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+[[noreturn]] static void erts_unavailable(const char* name) {
+    fprintf(stderr, "matter_nif_bench: %s needs the Erlang VM\n", name);
+    abort();
+}
+
+extern "C" {
+#define ERL_NIF_API_FUNC_DECL(RET_TYPE, NAME, ARGS) \
+    RET_TYPE NAME ARGS { erts_unavailable(#NAME); }
+#include <erl_nif_api_funcs.h>
+#undef ERL_NIF_API_FUNC_DECL
+}
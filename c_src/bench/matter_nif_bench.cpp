@@ -0,0 +1,235 @@
+// Native microbenchmarks for the NIF's BEAM-independent hot paths
+//
+// Builds the NIF source itself (stub mode, without ERL_NIF_INIT) into a
+// standalone binary, so the lock, store, ring and statistics code measured
+// here is exactly what ships. Anything that needs an ErlNifEnv is measured
+// from Elixir by `mix matterlix.bench` instead.
+//
+// Usage: matter_nif_bench [iterations] [max_threads]
+// Prints one JSON object to stdout.
+
+#define MATTER_NIF_BENCH 1
+#include "../matter_nif.cpp"
+
+#include <cinttypes>
+#include <cstdlib>
+
+namespace {
+
+using BenchClock = std::chrono::steady_clock;
+
+struct BenchResult {
+    std::string name;
+    unsigned threads;
+    uint64_t ops;
+    double seconds;
+};
+
+std::vector<BenchResult> g_results;
+
+// Keeps the optimizer from discarding a computed value
+template <typename T>
+void keep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+template <typename Fn>
+void bench(const char* name, uint64_t iterations, Fn&& fn) {
+    // Warm up caches and branch predictors before timing
+    for (uint64_t i = 0; i < iterations / 10; i++) {
+        fn(i);
+    }
+
+    auto start = BenchClock::now();
+    for (uint64_t i = 0; i < iterations; i++) {
+        fn(i);
+    }
+    std::chrono::duration<double> elapsed = BenchClock::now() - start;
+    g_results.push_back({name, 1, iterations, elapsed.count()});
+}
+
+// Run `fn` on `threads` threads at once, `iterations` calls each
+template <typename Fn>
+void bench_threads(const char* name, unsigned threads, uint64_t iterations, Fn&& fn) {
+    std::atomic<unsigned> ready{0};
+    std::atomic<bool> go{false};
+    std::vector<std::thread> workers;
+
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            for (uint64_t i = 0; i < iterations; i++) {
+                fn(i);
+            }
+        });
+    }
+
+    while (ready.load() != threads) {
+        std::this_thread::yield();
+    }
+    auto start = BenchClock::now();
+    go.store(true, std::memory_order_release);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    std::chrono::duration<double> elapsed = BenchClock::now() - start;
+    g_results.push_back({name, threads, iterations * threads, elapsed.count()});
+}
+
+void bench_statistics(uint64_t iterations) {
+    LatencyHistogram histogram;
+    bench("histogram_record", iterations, [&](uint64_t i) {
+        histogram.Record(std::chrono::nanoseconds(i & 0xFFFFF));
+    });
+}
+
+void bench_locks(uint64_t iterations, unsigned max_threads) {
+    bench("global_mutex_lock", iterations, [](uint64_t) {
+        GlobalMutexLock lock;
+    });
+
+    bench("stack_lock", iterations, [](uint64_t) {
+        lock_chip_stack();
+        unlock_chip_stack();
+    });
+
+    for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+        bench_threads("global_mutex_lock_contended", threads, iterations / threads, [](uint64_t) {
+            GlobalMutexLock lock;
+        });
+    }
+}
+
+void bench_store(uint64_t iterations) {
+    constexpr size_t kPaths = sizeof(kStubAttributes) / sizeof(kStubAttributes[0]);
+
+    lock_chip_stack();
+    StubAttributeStore& store = stub_store();
+
+    bench("stub_store_find_hit", iterations, [&](uint64_t i) {
+        const StubAttributeSpec& spec = kStubAttributes[i % kPaths];
+        keep(store.Find(spec.endpoint_id, spec.cluster_id, spec.attribute_id));
+    });
+
+    bench("stub_store_find_miss", iterations, [&](uint64_t i) {
+        keep(store.Find(2, 0x0006, static_cast<uint32_t>(i)));
+    });
+
+    // Bridged endpoint churn: external slots come and go while the table
+    // stays loaded with 256 endpoints' worth of attributes
+    StubAttributeStore bridged;
+    std::vector<uint8_t> arena(256 * kBridgeSlotBytes);
+    bridged.Reserve(256 * kBridgeMaxAttributes);
+    bridged.SetExternalArena(arena.data());
+    for (uint16_t ep = 2; ep < 258; ep++) {
+        bridged.DefineExternal(ep, 0x0039, 0x0011, kZclBoolean, 1, false, (ep - 2) * kBridgeSlotBytes);
+    }
+    bench("stub_store_external_churn", iterations, [&](uint64_t i) {
+        uint16_t ep = static_cast<uint16_t>(2 + (i & 0xFF));
+        bridged.DefineExternal(ep, 0x0006, 0x0000, kZclBoolean, 1, false, (ep - 2) * kBridgeSlotBytes + 1);
+        keep(bridged.RemoveExternal(ep, 0x0006, 0x0000));
+    });
+
+    unlock_chip_stack();
+
+    bench("change_filter_accepts", iterations, [](uint64_t i) {
+        keep(change_filter_accepts(1, 0x0006, static_cast<uint32_t>(i & 0xFF)));
+    });
+}
+
+void bench_event_ring(uint64_t iterations) {
+    AttributeChangeRing ring(1024);
+    AttributeChangeRecord record = {};
+    AttributeChangeRecord out[16];
+
+    bench("event_ring_push_pop", iterations, [&](uint64_t i) {
+        record.attribute_id = static_cast<uint32_t>(i);
+        ring.Push(record);
+        if ((i & 15) == 15) {
+            keep(ring.Pop(out, 16));
+        }
+    });
+
+    // One producer, one consumer as with the CHIP thread and drain thread;
+    // ops counts records that made it through
+    AttributeChangeRing spsc(1024);
+    std::atomic<bool> done{false};
+    uint64_t consumed = 0;
+
+    auto start = BenchClock::now();
+    std::thread consumer([&] {
+        AttributeChangeRecord batch[64];
+        while (!done.load(std::memory_order_acquire) || spsc.Size() > 0) {
+            size_t popped = spsc.Pop(batch, 64);
+            consumed += popped;
+            if (popped == 0) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    for (uint64_t i = 0; i < iterations; i++) {
+        record.attribute_id = static_cast<uint32_t>(i);
+        while (!spsc.Push(record)) {
+            std::this_thread::yield();
+        }
+    }
+    done.store(true, std::memory_order_release);
+    consumer.join();
+    std::chrono::duration<double> elapsed = BenchClock::now() - start;
+    g_results.push_back({"event_ring_spsc", 2, consumed, elapsed.count()});
+}
+
+void bench_storage(uint64_t iterations) {
+    // Counter-style updates of a loaded table, absorbed in memory until the
+    // next flush; only the final write of the table touches the file
+    StorageConfig config;
+    config.path = "/tmp/matter_nif_bench_kvs.bin";
+    {
+        CoalescingStore store(config);
+        char key[16];
+        for (int k = 0; k < 64; k++) {
+            snprintf(key, sizeof(key), "g/k%d", k);
+            store.Set(key, key, static_cast<uint16_t>(strlen(key)));
+        }
+        bench("storage_set_coalesced", iterations, [&](uint64_t i) {
+            uint32_t value = static_cast<uint32_t>(i);
+            keep(store.Set(i & 1 ? "g/k1" : "g/k2", &value, sizeof(value)));
+        });
+    }
+    unlink(config.path.c_str());
+}
+
+void print_results() {
+    printf("{\"schema\":1,\"results\":[");
+    for (size_t i = 0; i < g_results.size(); i++) {
+        const BenchResult& result = g_results[i];
+        double ns_per_op = result.ops ? result.seconds * 1e9 / static_cast<double>(result.ops) : 0;
+        double ops_per_sec = result.seconds > 0 ? static_cast<double>(result.ops) / result.seconds : 0;
+        printf("%s{\"name\":\"%s\",\"threads\":%u,\"ops\":%" PRIu64 ",\"ns_per_op\":%.2f,\"ops_per_sec\":%.0f}",
+               i ? "," : "", result.name.c_str(), result.threads, result.ops, ns_per_op, ops_per_sec);
+    }
+    printf("]}\n");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    uint64_t iterations = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+    unsigned max_threads = argc > 2 ? static_cast<unsigned>(strtoul(argv[2], nullptr, 10)) : 8;
+    if (iterations == 0 || max_threads == 0) {
+        fprintf(stderr, "usage: %s [iterations] [max_threads]\n", argv[0]);
+        return 1;
+    }
+
+    bench_statistics(iterations);
+    bench_locks(iterations, max_threads);
+    bench_store(iterations);
+    bench_event_ring(iterations);
+    bench_storage(iterations);
+
+    print_results();
+    return 0;
+}
@@ -6,12 +6,15 @@
 #   MATTER_GN_ROOT      - GN root path (default: examples/lighting-app/linux)
 #   MATTER_OUTPUT_NAME   - Output directory suffix (default: light)
 #   MATTER_EXECUTABLE    - Executable name (default: chip-lighting-app)
+#   MATTER_CONFIG_DEFINES - Space-separated NAME=VALUE CHIP config overrides
+#                           (pool sizes), applied on top of the app's project config
 set -e
 
 MATTER_SDK="/matter/connectedhomeip"
 MATTER_GN_ROOT="${MATTER_GN_ROOT:-examples/lighting-app/linux}"
 MATTER_OUTPUT_NAME="${MATTER_OUTPUT_NAME:-light}"
 MATTER_EXECUTABLE="${MATTER_EXECUTABLE:-chip-lighting-app}"
+MATTER_CONFIG_DEFINES="${MATTER_CONFIG_DEFINES:-}"
 OUTPUT_DIR="$MATTER_SDK/out/linux-arm64-${MATTER_OUTPUT_NAME}"
 # Use a temp dir for the environment - NEVER touch the host's .environment
 ENV_DIR="/tmp/matter-env"
@@ -72,7 +75,7 @@ echo "GN: $(which gn)"
 echo "Ninja: $(which ninja)"
 
 echo "=== Running GN gen ==="
-gn gen "$OUTPUT_DIR" --root="$MATTER_GN_ROOT" --args='
+GN_ARGS='
   target_cpu="arm64"
   target_os="linux"
   treat_warnings_as_errors=false
@@ -81,6 +84,35 @@ gn gen "$OUTPUT_DIR" --root="$MATTER_GN_ROOT" --args='
   chip_enable_ble=true
   is_clang=false
 '
+gn gen "$OUTPUT_DIR" --root="$MATTER_GN_ROOT" --args="$GN_ARGS"
+
+# Config overrides go in wrappers around the app's project config headers
+# (CHIP core, device layer and system layer each include their own). They
+# live under gen/include, which is on the include path of both the SDK and
+# the NIF build, so both see the same pool sizes.
+if [ -n "$MATTER_CONFIG_DEFINES" ]; then
+    echo "=== Applying config overrides: $MATTER_CONFIG_DEFINES ==="
+    CONFIG_ARGS=""
+    for arg in chip_project_config_include chip_device_project_config_include chip_system_project_config_include; do
+        APP_CONFIG=$(gn args "$OUTPUT_DIR" --list="$arg" --short | sed -n "s/^$arg = \"\(.*\)\"\$/\1/p")
+        CONFIG_HEADER="matterlix/${arg}.h"
+        mkdir -p "$OUTPUT_DIR/gen/include/matterlix"
+        {
+            echo "// Generated by docker/build.sh from MATTER_CONFIG_DEFINES"
+            echo "#pragma once"
+            if [ -n "$APP_CONFIG" ]; then
+                echo "#include $APP_CONFIG"
+            fi
+            for define in $MATTER_CONFIG_DEFINES; do
+                echo "#undef ${define%%=*}"
+                echo "#define ${define%%=*} ${define#*=}"
+            done
+        } > "$OUTPUT_DIR/gen/include/$CONFIG_HEADER"
+        CONFIG_ARGS="$CONFIG_ARGS $arg=\"<$CONFIG_HEADER>\""
+    done
+
+    gn gen "$OUTPUT_DIR" --root="$MATTER_GN_ROOT" --args="$GN_ARGS $CONFIG_ARGS"
+fi
 
 echo "=== Building with Ninja (this may take a while) ==="
 ninja -C "$OUTPUT_DIR"
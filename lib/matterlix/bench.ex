@@ -0,0 +1,450 @@
+defmodule Matterlix.Bench do
+  @moduledoc """
+  Benchmarks for the NIF and GenServer hot paths.
+
+  Runs against whichever NIF is loaded: the in-memory stub attribute store
+  on a host build, or the Matter SDK on a device, where the server must
+  already be running. On the host use `mix matterlix.bench`; on a device,
+  from IEx:
+
+      Matterlix.Bench.run(output: "/data/bench.json")
+
+  ## Benchmarks
+
+    * `nif.set_attribute`, `nif.get_attribute`, `nif.set_attribute_async` -
+      direct NIF calls from one process
+    * `genserver.set_attribute`, `genserver.get_attribute` - the same
+      operations through a dedicated `Matterlix.Matter` server
+    * `cache.get_attribute` - `Matterlix.Matter.get_attribute/4` answered
+      from the attribute cache
+    * `change.handler_latency` - from an attribute write until the change
+      reaches the server's `Matterlix.Handler`
+    * `concurrency.nif_get_attribute`, `concurrency.genserver_get_attribute`,
+      `concurrency.direct_get_attribute` - aggregate throughput of 1..N
+      processes calling at once, the last through `Matterlix.Matter.Direct`
+    * `concurrency.nif_set_get_attribute` - 1..N processes alternating
+      writes and reads. With the get benchmark, shows how attribute I/O
+      scales with the scheduler count; both report a `speedup` over the
+      smallest process count (`nil` if that run completed no operations)
+    * `bridge.add_endpoints` - bridging 200 devices in one
+      `nif_add_bridged_endpoints/3` call and removing them again, with the
+      arena's memory per endpoint (skipped if the bridge is in use or, with
+      the SDK, the profile has no dynamic endpoints)
+    * `startup` - `nif_start_server_async/1` until `{:matter_started, :ok}`,
+      with the per-phase durations (skipped if the server is already running).
+      Runs first and leaves the server running for the other benchmarks.
+
+  ## Results
+
+  `run/1` returns a map that encodes directly as JSON:
+
+      %{
+        schema: 1,
+        system: %{matterlix: "0.3.1", otp: "27", elixir: "1.18.1",
+                  arch: "aarch64-unknown-linux-gnu", schedulers: 4, sdk_enabled: false},
+        results: [
+          %{name: "nif.set_attribute", processes: 1, ops: 10000, ops_per_sec: 512_000.0,
+            latency_us: %{mean: 1.9, p50: 1.7, p90: 2.4, p99: 6.1, max: 88.0}},
+          ...
+        ]
+      }
+
+  `ops_per_sec` is wall-clock throughput over all processes. Latencies are
+  per operation as seen by the caller.
+  """
+
+  alias Matterlix.Matter
+  alias Matterlix.Matter.NIF
+
+  # ColorTemperatureMireds: a uint16 in the stub layout and on the lighting app
+  @endpoint 1
+  @cluster 0x0300
+  @attribute 0x0007
+
+  @default_iterations 10_000
+  @default_concurrency [1, 2, 4, 8]
+  @change_timeout 1_000
+
+  # Bridged under the aggregator (`@endpoint`) in the bridge benchmark
+  @bridge_devices 200
+  @bridge_first_endpoint 2
+
+  defmodule Handler do
+    @moduledoc false
+    @behaviour Matterlix.Handler
+
+    @impl true
+    def handle_attribute_change(endpoint_id, cluster_id, attribute_id, _type, value) do
+      if pid = :persistent_term.get({Matterlix.Bench, :listener}, nil) do
+        send(pid, {:matterlix_bench_change, {endpoint_id, cluster_id, attribute_id}, value})
+      end
+
+      :ok
+    end
+  end
+
+  @doc """
+  Run the benchmarks and return the results.
+
+  ## Options
+  - `:iterations` - operations per benchmark (default: #{@default_iterations})
+  - `:concurrency` - process counts for the concurrency benchmarks
+    (default: #{inspect(@default_concurrency)})
+  - `:only` - list of benchmark name prefixes to run, e.g. `["nif.", "startup"]`
+  - `:output` - also write the results as JSON to this path
+  """
+  @spec run(keyword()) :: map()
+  def run(opts \\ []) do
+    iterations = Keyword.get(opts, :iterations, @default_iterations)
+    concurrency = Keyword.get(opts, :concurrency, @default_concurrency)
+    only = Keyword.get(opts, :only)
+
+    {:ok, ctx} = NIF.nif_init()
+    {:ok, info} = NIF.nif_get_info(ctx)
+
+    benchmarks = [
+      {"startup", fn -> bench_startup(ctx) end},
+      {"nif.set_attribute", fn -> bench_nif_set(ctx, iterations) end},
+      {"nif.get_attribute", fn -> bench_nif_get(ctx, iterations) end},
+      {"nif.set_attribute_async", fn -> bench_nif_set_async(ctx, iterations) end},
+      {"genserver.", fn -> with_server(&bench_genserver(&1, iterations)) end},
+      {"cache.get_attribute",
+       fn -> with_server(&bench_cached_get(&1, iterations), attribute_cache: true) end},
+      {"change.handler_latency",
+       fn -> with_server(fn _server -> bench_change_latency(ctx, iterations) end) end},
+      {"concurrency.nif_get_attribute",
+       fn -> with_speedup(Enum.map(concurrency, &bench_concurrent_nif(ctx, &1, iterations))) end},
+      {"concurrency.nif_set_get_attribute",
+       fn ->
+         with_speedup(Enum.map(concurrency, &bench_concurrent_nif_io(ctx, &1, iterations)))
+       end},
+      {"concurrency.genserver_get_attribute",
+       fn -> with_server(&bench_concurrent_server(&1, concurrency, iterations)) end},
+      {"concurrency.direct_get_attribute",
+       fn -> with_server(&bench_concurrent_direct(&1, concurrency, iterations)) end},
+      {"bridge.add_endpoints", fn -> bench_bridge(ctx) end}
+    ]
+
+    results =
+      benchmarks
+      |> Enum.filter(fn {name, _fun} -> selected?(name, only) end)
+      |> Enum.flat_map(fn {_name, fun} -> List.wrap(fun.()) end)
+
+    # A started server would outlive the context and be taken over by the
+    # next Matterlix.Matter
+    if Enum.any?(results, &(&1.name == "startup" and not Map.has_key?(&1, :skipped))) do
+      NIF.nif_stop_server(ctx)
+    end
+
+    report = %{schema: 1, system: system_info(info), results: results}
+
+    if path = Keyword.get(opts, :output) do
+      File.write!(path, JSON.encode!(report))
+    end
+
+    report
+  end
+
+  defp selected?(_name, nil), do: true
+
+  defp selected?(name, only) do
+    Enum.any?(only, &(String.starts_with?(name, &1) or String.starts_with?(&1, name)))
+  end
+
+  # Benchmarks
+
+  defp bench_nif_set(ctx, iterations) do
+    check!(NIF.nif_set_attribute(ctx, @endpoint, @cluster, @attribute, value(0)))
+
+    measure("nif.set_attribute", iterations, fn i ->
+      NIF.nif_set_attribute(ctx, @endpoint, @cluster, @attribute, value(i))
+    end)
+  end
+
+  defp bench_nif_get(ctx, iterations) do
+    check!(NIF.nif_get_attribute(ctx, @endpoint, @cluster, @attribute))
+
+    measure("nif.get_attribute", iterations, fn _i ->
+      NIF.nif_get_attribute(ctx, @endpoint, @cluster, @attribute)
+    end)
+  end
+
+  defp bench_nif_set_async(ctx, iterations) do
+    measure("nif.set_attribute_async", iterations, fn i ->
+      {:ok, ref} = NIF.nif_set_attribute_async(ctx, @endpoint, @cluster, @attribute, value(i))
+
+      receive do
+        {:matter_reply, ^ref, result} -> result
+      end
+    end)
+  end
+
+  defp bench_genserver(server, iterations) do
+    [
+      measure("genserver.set_attribute", iterations, fn i ->
+        Matter.set_attribute(server, @endpoint, @cluster, @attribute, value(i))
+      end),
+      measure("genserver.get_attribute", iterations, fn _i ->
+        Matter.get_attribute(server, @endpoint, @cluster, @attribute)
+      end)
+    ]
+  end
+
+  defp bench_cached_get(server, iterations) do
+    check!(Matter.get_attribute(server, @endpoint, @cluster, @attribute))
+
+    measure("cache.get_attribute", iterations, fn _i ->
+      Matter.get_attribute(server, @endpoint, @cluster, @attribute)
+    end)
+  end
+
+  # The bench server is the listener, so each write travels NIF -> server ->
+  # Bench.Handler -> this process
+  defp bench_change_latency(ctx, iterations) do
+    :persistent_term.put({__MODULE__, :listener}, self())
+
+    try do
+      measure("change.handler_latency", iterations, fn i ->
+        expected = value(i)
+        :ok = NIF.nif_set_attribute(ctx, @endpoint, @cluster, @attribute, expected)
+
+        receive do
+          {:matterlix_bench_change, {@endpoint, @cluster, @attribute}, ^expected} -> :ok
+        after
+          @change_timeout -> raise "no attribute change delivered within #{@change_timeout}ms"
+        end
+      end)
+    after
+      :persistent_term.erase({__MODULE__, :listener})
+    end
+  end
+
+  defp bench_concurrent_nif(ctx, processes, iterations) do
+    measure_concurrent("concurrency.nif_get_attribute", processes, iterations, fn _i ->
+      NIF.nif_get_attribute(ctx, @endpoint, @cluster, @attribute)
+    end)
+  end
+
+  defp bench_concurrent_nif_io(ctx, processes, iterations) do
+    measure_concurrent("concurrency.nif_set_get_attribute", processes, iterations, fn i ->
+      if rem(i, 2) == 0 do
+        NIF.nif_set_attribute(ctx, @endpoint, @cluster, @attribute, value(i))
+      else
+        NIF.nif_get_attribute(ctx, @endpoint, @cluster, @attribute)
+      end
+    end)
+  end
+
+  defp bench_concurrent_server(server, concurrency, iterations) do
+    for processes <- concurrency do
+      measure_concurrent("concurrency.genserver_get_attribute", processes, iterations, fn _i ->
+        Matter.get_attribute(server, @endpoint, @cluster, @attribute)
+      end)
+    end
+  end
+
+  defp bench_concurrent_direct(server, concurrency, iterations) do
+    for processes <- concurrency do
+      measure_concurrent("concurrency.direct_get_attribute", processes, iterations, fn _i ->
+        Matter.Direct.get_attribute(server, @endpoint, @cluster, @attribute)
+      end)
+    end
+  end
+
+  defp bench_bridge(ctx) do
+    devices = for i <- 1..@bridge_devices, do: {:on_off_light, "Bench #{i}", "bench-#{i}"}
+
+    case NIF.nif_configure_bridge(ctx, @bridge_devices, @bridge_first_endpoint) do
+      :ok ->
+        try do
+          began = System.monotonic_time()
+          {:ok, added} = NIF.nif_add_bridged_endpoints(ctx, @endpoint, devices)
+          add_elapsed = System.monotonic_time() - began
+
+          endpoints = for {:ok, endpoint_id} <- added, do: endpoint_id
+          {:ok, stats} = NIF.nif_get_bridge_stats(ctx)
+
+          began = System.monotonic_time()
+          {:ok, removed} = NIF.nif_remove_bridged_endpoints(ctx, endpoints)
+          remove_elapsed = System.monotonic_time() - began
+          Enum.each(removed, &check!/1)
+
+          if length(endpoints) != @bridge_devices do
+            raise "bridging failed: #{inspect(Enum.reject(added, &match?({:ok, _}, &1)))}"
+          end
+
+          %{
+            name: "bridge.add_endpoints",
+            processes: 1,
+            ops: @bridge_devices,
+            latency_us: %{total: to_us(add_elapsed), remove: to_us(remove_elapsed)},
+            locked_us: stats.last_add_us,
+            bytes_per_endpoint: stats.bytes_per_endpoint,
+            arena_bytes: stats.arena_bytes
+          }
+        after
+          NIF.nif_configure_bridge(ctx, 0, @bridge_first_endpoint)
+        end
+
+      {:error, reason} ->
+        %{name: "bridge.add_endpoints", skipped: reason}
+    end
+  end
+
+  defp bench_startup(ctx) do
+    began = System.monotonic_time()
+
+    case NIF.nif_start_server_async(ctx) do
+      :ok ->
+        phases = collect_start_phases(%{})
+        elapsed = System.monotonic_time() - began
+
+        %{
+          name: "startup",
+          processes: 1,
+          ops: 1,
+          latency_us: %{total: to_us(elapsed)},
+          phases_us: phases
+        }
+
+      {:error, reason} ->
+        %{name: "startup", skipped: reason}
+    end
+  end
+
+  defp collect_start_phases(phases) do
+    receive do
+      {:matter_start_phase, phase, elapsed_us} ->
+        collect_start_phases(Map.put(phases, phase, elapsed_us))
+
+      {:matter_started, :ok} ->
+        phases
+
+      {:matter_started, {:error, reason}} ->
+        raise "server start failed: #{inspect(reason)}"
+    end
+  end
+
+  # Measurement
+
+  defp measure(name, iterations, fun) do
+    # Warm up: first calls pay for code loading and cold caches
+    for i <- 1..min(iterations, 100), do: fun.(i)
+
+    began = System.monotonic_time()
+    durations = run_timed(fun, iterations)
+    elapsed = System.monotonic_time() - began
+
+    result(name, 1, iterations, elapsed, durations)
+  end
+
+  defp measure_concurrent(name, processes, iterations, fun) do
+    per_process = max(div(iterations, processes), 1)
+    parent = self()
+
+    pids =
+      for _ <- 1..processes do
+        spawn_link(fn ->
+          receive do
+            :go -> send(parent, {:matterlix_bench_done, self(), run_timed(fun, per_process)})
+          end
+        end)
+      end
+
+    began = System.monotonic_time()
+    Enum.each(pids, &send(&1, :go))
+
+    durations =
+      Enum.flat_map(pids, fn pid ->
+        receive do
+          {:matterlix_bench_done, ^pid, durations} -> durations
+        end
+      end)
+
+    elapsed = System.monotonic_time() - began
+    result(name, processes, per_process * processes, elapsed, durations)
+  end
+
+  defp run_timed(fun, iterations) do
+    for i <- 1..iterations do
+      began = System.monotonic_time()
+      fun.(i)
+      System.monotonic_time() - began
+    end
+  end
+
+  defp result(name, processes, ops, elapsed, durations) do
+    sorted = durations |> Enum.sort() |> List.to_tuple()
+    count = tuple_size(sorted)
+
+    %{
+      name: name,
+      processes: processes,
+      ops: ops,
+      ops_per_sec: Float.round(ops / max(to_seconds(elapsed), 1.0e-9), 1),
+      latency_us: %{
+        mean: to_us(Enum.sum(durations) / count),
+        p50: to_us(percentile(sorted, 0.50)),
+        p90: to_us(percentile(sorted, 0.90)),
+        p99: to_us(percentile(sorted, 0.99)),
+        max: to_us(elem(sorted, count - 1))
+      }
+    }
+  end
+
+  # Throughput of each run relative to the first, fewest-process run; nil
+  # when that run completed no operations
+  defp with_speedup([%{ops_per_sec: baseline} | _] = results) when baseline == 0 do
+    Enum.map(results, &Map.put(&1, :speedup, nil))
+  end
+
+  defp with_speedup([first | _] = results) do
+    Enum.map(results, &Map.put(&1, :speedup, Float.round(&1.ops_per_sec / first.ops_per_sec, 2)))
+  end
+
+  defp percentile(sorted, p) do
+    index = min(round(p * (tuple_size(sorted) - 1)), tuple_size(sorted) - 1)
+    elem(sorted, index)
+  end
+
+  # Helpers
+
+  defp with_server(fun, opts \\ []) do
+    name = :"matterlix_bench_#{System.unique_integer([:positive])}"
+    {:ok, server} = Matter.start_link([name: name, handler: Handler] ++ opts)
+
+    try do
+      fun.(server)
+    after
+      GenServer.stop(server)
+    end
+  end
+
+  # Distinct consecutive values so every write is a change
+  defp value(i), do: 153 + rem(i, 347)
+
+  defp check!(:ok), do: :ok
+  defp check!({:ok, _value}), do: :ok
+
+  defp check!({:error, reason}) do
+    raise "attribute #{inspect({@endpoint, @cluster, @attribute})} not usable: " <>
+            "#{inspect(reason)} (on a device the Matter server must be started)"
+  end
+
+  defp system_info(info) do
+    %{
+      matterlix: to_string(Application.spec(:matterlix, :vsn)),
+      otp: to_string(:erlang.system_info(:otp_release)),
+      elixir: System.version(),
+      arch: to_string(:erlang.system_info(:system_architecture)),
+      schedulers: System.schedulers_online(),
+      sdk_enabled: Map.get(info, :sdk_enabled, false)
+    }
+  end
+
+  defp to_seconds(native), do: native / System.convert_time_unit(1, :second, :native)
+
+  defp to_us(native) do
+    Float.round(native * 1_000_000 / System.convert_time_unit(1, :second, :native), 2)
+  end
+end
@@ -20,18 +20,64 @@ defmodule Matterlix.DeviceProfiles do
   | `:thermostat` | Thermostat | HVAC control |
   | `:air_quality_sensor` | AirQuality, Temperature, Humidity | Environmental sensing |
   | `:all_clusters` | All standard clusters | Development/testing |
+  | `:bridge` | Aggregator + dynamic endpoints | Bridging non-Matter devices |
 
   ## Building for a Profile
 
       mix matterlix.build_sdk --profile light
+
+  ## SDK config
+
+  A profile's `:sdk_config` sizes the Matter stack's static pools, so
+  simple sensors can give memory back and bridges can take more. Each key
+  sets a CHIP config define in the SDK build, see `sdk_config_defines/1`:
+
+  | Key | CHIP define |
+  |-----|-------------|
+  | `:exchange_contexts` | `CHIP_CONFIG_MAX_EXCHANGE_CONTEXTS` |
+  | `:secure_sessions` | `CHIP_CONFIG_SECURE_SESSION_POOL_SIZE` |
+  | `:reads` | `CHIP_IM_MAX_NUM_READS` |
+  | `:subscriptions` | `CHIP_IM_MAX_NUM_SUBSCRIPTIONS` |
+  | `:fabrics` | `CHIP_CONFIG_MAX_FABRICS` |
+  | `:packet_buffers` | `CHIP_SYSTEM_CONFIG_PACKETBUFFER_POOL_SIZE` (0: heap) |
+  | `:dynamic_endpoints` | `CHIP_DEVICE_CONFIG_DYNAMIC_ENDPOINT_COUNT` |
+  | `:statistics` | `CHIP_SYSTEM_CONFIG_PROVIDE_STATISTICS` (boolean) |
+
+  Keys left out keep the example app's defaults. `mix matterlix.build_sdk
+  --config key=value` overrides a profile's values for one build, and
+  `Matterlix.Matter.memory_stats/1` reports the sizes a build ended up with.
+  The Matter specification requires at least 5 fabrics and 3 subscriptions
+  per fabric.
   """
 
+  @type sdk_config :: [
+          {:exchange_contexts | :secure_sessions | :reads | :subscriptions | :fabrics,
+           pos_integer()}
+          | {:packet_buffers | :dynamic_endpoints, non_neg_integer()}
+          | {:statistics, boolean()}
+        ]
+
   @type profile :: %{
-          gn_root: String.t(),
-          executable: String.t(),
-          description: String.t()
+          required(:gn_root) => String.t(),
+          required(:executable) => String.t(),
+          required(:description) => String.t(),
+          optional(:sdk_config) => sdk_config()
         }
 
+  @sdk_config_defines %{
+    exchange_contexts: "CHIP_CONFIG_MAX_EXCHANGE_CONTEXTS",
+    secure_sessions: "CHIP_CONFIG_SECURE_SESSION_POOL_SIZE",
+    reads: "CHIP_IM_MAX_NUM_READS",
+    subscriptions: "CHIP_IM_MAX_NUM_SUBSCRIPTIONS",
+    fabrics: "CHIP_CONFIG_MAX_FABRICS",
+    packet_buffers: "CHIP_SYSTEM_CONFIG_PACKETBUFFER_POOL_SIZE",
+    dynamic_endpoints: "CHIP_DEVICE_CONFIG_DYNAMIC_ENDPOINT_COUNT",
+    statistics: "CHIP_SYSTEM_CONFIG_PROVIDE_STATISTICS"
+  }
+
+  # Sizes for which 0 is meaningful (heap allocation, no dynamic endpoints)
+  @zero_allowed [:packet_buffers, :dynamic_endpoints]
+
   @profiles %{
     light: %{
       gn_root: "examples/lighting-app/linux",
@@ -41,7 +87,8 @@ defmodule Matterlix.DeviceProfiles do
     contact_sensor: %{
       gn_root: "examples/contact-sensor-app/linux",
       executable: "contact-sensor-app",
-      description: "Contact sensor (BooleanState)"
+      description: "Contact sensor (BooleanState)",
+      sdk_config: [fabrics: 5]
     },
     lock: %{
       gn_root: "examples/lock-app/linux",
@@ -56,12 +103,20 @@ defmodule Matterlix.DeviceProfiles do
     air_quality_sensor: %{
       gn_root: "examples/air-quality-sensor-app/linux",
       executable: "air-quality-sensor-app",
-      description: "Air quality + temperature + humidity"
+      description: "Air quality + temperature + humidity",
+      sdk_config: [fabrics: 5]
     },
     all_clusters: %{
       gn_root: "examples/all-clusters-app/linux",
       executable: "chip-all-clusters-app",
-      description: "All clusters (development/testing)"
+      description: "All clusters (development/testing)",
+      sdk_config: [statistics: true]
+    },
+    bridge: %{
+      gn_root: "examples/bridge-app/linux",
+      executable: "chip-bridge-app",
+      description: "Bridge (aggregator with dynamic endpoints)",
+      sdk_config: [dynamic_endpoints: 256]
     }
   }
 
@@ -89,4 +144,48 @@ defmodule Matterlix.DeviceProfiles do
   @doc "Check if a profile name is valid."
   @spec valid?(atom()) :: boolean()
   def valid?(name), do: Map.has_key?(@profiles, name)
+
+  @doc """
+  The CHIP config defines for an `:sdk_config` keyword list, as
+  `"NAME=VALUE"` strings sorted by name. Raises on unknown keys or
+  invalid values.
+
+  ## Example
+
+      iex> Matterlix.DeviceProfiles.sdk_config_defines(fabrics: 5, statistics: true)
+      ["CHIP_CONFIG_MAX_FABRICS=5", "CHIP_SYSTEM_CONFIG_PROVIDE_STATISTICS=1"]
+  """
+  @spec sdk_config_defines(sdk_config()) :: [String.t()]
+  def sdk_config_defines(config) do
+    config
+    |> Enum.map(fn {key, value} -> "#{define!(key)}=#{define_value!(key, value)}" end)
+    |> Enum.sort()
+  end
+
+  @doc "The `:sdk_config` keys `sdk_config_defines/1` accepts."
+  @spec sdk_config_keys() :: [atom()]
+  def sdk_config_keys, do: @sdk_config_defines |> Map.keys() |> Enum.sort()
+
+  defp define!(key) do
+    case Map.fetch(@sdk_config_defines, key) do
+      {:ok, define} ->
+        define
+
+      :error ->
+        raise ArgumentError,
+              "Unknown SDK config key: #{inspect(key)}. Available: #{inspect(sdk_config_keys())}"
+    end
+  end
+
+  defp define_value!(:statistics, value) when is_boolean(value), do: if(value, do: 1, else: 0)
+
+  defp define_value!(key, value) when key in @zero_allowed and is_integer(value) and value >= 0,
+    do: value
+
+  defp define_value!(key, value) when key != :statistics and is_integer(value) and value > 0,
+    do: value
+
+  defp define_value!(key, value) do
+    raise ArgumentError, "Invalid value for SDK config #{inspect(key)}: #{inspect(value)}"
+  end
 end
@@ -35,14 +35,20 @@ defmodule Matterlix.Handler do
   - `cluster_id` — the cluster (e.g. 0x0006 for On/Off)
   - `attribute_id` — the attribute within the cluster (e.g. 0x0000 for OnOff)
   - `type` — the ZCL attribute type as an integer
-  - `value` — the new value (boolean, integer, or nil for unsupported types)
+  - `value` — the new value: a boolean, integer (also enums and bitmaps), float,
+    or binary (char and octet strings); `nil` for a null value of a nullable
+    attribute and for unsupported types (lists, structs)
+
+  When coalescing is configured (see `Matterlix.Matter.set_coalescing/2`),
+  this is called with the latest value of a rapidly changing attribute rather
+  than every intermediate step, and always with the final value.
   """
   @callback handle_attribute_change(
               endpoint_id :: non_neg_integer(),
               cluster_id :: non_neg_integer(),
               attribute_id :: non_neg_integer(),
               type :: non_neg_integer(),
-              value :: boolean() | integer() | nil
+              value :: boolean() | integer() | float() | binary() | nil
             ) :: :ok | {:error, term()}
 
   @doc """
@@ -55,8 +61,22 @@ defmodule Matterlix.Handler do
   """
   @callback handle_network_added(ssid :: binary(), credentials :: binary()) :: :ok
 
+  @doc """
+  Called for each OTA software update event when the `:ota` option is set,
+  see `Matterlix.Matter.OTA`.
+
+  `info` holds the payload `:offset` and `:total` bytes (`nil` until known)
+  and, for `:error`, the `:reason`. On `:apply` the new image has been
+  written and the OTA provider allows it to run: reboot into it.
+  """
+  @callback handle_ota_event(
+              event :: :download_started | :progress | :downloaded | :aborted | :error | :apply,
+              info :: map()
+            ) :: :ok
+
   @optional_callbacks [
     handle_commissioning_complete: 1,
-    handle_network_added: 2
+    handle_network_added: 2,
+    handle_ota_event: 2
   ]
 end
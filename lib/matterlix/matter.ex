@@ -32,29 +32,160 @@ defmodule Matterlix.Matter do
   | 0x0300     | Color Control  | Color temperature, hue, sat    |
   | 0x0402     | Temperature    | Temperature measurement        |
   | 0x0405     | Humidity       | Relative humidity              |
+
+  ## Telemetry
+
+  If `:telemetry` is available, lifecycle timings are emitted as events
+  (durations in native time units):
+
+    * `[:matterlix, :init]` - `%{duration}` of `NIF.nif_init/0`, metadata `%{result}`
+    * `[:matterlix, :start, :phase]` - `%{duration}` of one start phase, metadata `%{phase}`
+    * `[:matterlix, :start, :stop]` - `%{duration}` of the whole start, metadata
+      `%{result, timings}` with the monotonic timestamps from `timings/1`
+
+  ## Attribute cache
+
+  With `attribute_cache: true`, `get_attribute/4` is answered from an ETS
+  table in the caller's process, without a message to the server or a NIF
+  call. The table is filled by reads that miss and kept current from the
+  attribute change notifications; a successful write through this server
+  drops the entry until the next read. It is cleared when the Matter server
+  stops or is factory reset.
+
+  Attributes whose changes never reach the server - excluded by the change
+  filter, or updated by the SDK without a change callback - should be
+  listed as volatile so they are always read through the NIF:
+
+      Matterlix.Matter.start_link(
+        attribute_cache: [volatile: [{1, 0x0402, :_}, {:_, 0x0028, 0x0004}]]
+      )
+
+  Handle reads (`get_attribute/2`) and `read_cluster/3` always go to the NIF.
+
+  ## Direct attribute access
+
+  Every call here is serialized through this process. For attribute I/O from
+  many processes, `Matterlix.Matter.Direct` calls the NIF from the caller
+  using the context this server publishes, leaving the server to the
+  lifecycle and callbacks.
+
+  ## Bridged devices
+
+  A bridge exposes the devices behind it (Zigbee, BLE, ...) as dynamic
+  endpoints under its aggregator endpoint. `configure_bridge/3` preallocates
+  their attribute storage once; `add_bridged_endpoints/3` then registers
+  devices of a built-in kind and returns their endpoint IDs, which work with
+  every attribute function here:
+
+      :ok = Matterlix.Matter.configure_bridge(pid, 64)
+      {:ok, [{:ok, ep}]} =
+        Matterlix.Matter.add_bridged_endpoints(pid, [{:temperature_sensor, "Attic", "ble-1"}])
+      :ok = Matterlix.Matter.set_attribute(pid, ep, 0x0402, 0x0000, 2150)
+
+  Bridged endpoints are removed when the Matter server stops.
+
+  ## Subscription reports
+
+  Every write normally marks its attribute for a report to each subscribed
+  controller. `write_transaction/2` defers the marking of a burst of writes
+  to its end, and `set_report_intervals/2` (or the `:report_intervals`
+  option) caps how often a cluster is reported, so controllers get one
+  consolidated report instead of one per attribute.
+
+  ## Handler dispatch
+
+  Attribute changes are passed to the handler inline, so a slow handler
+  holds up the server. The `:dispatch` option hands them to a pool of
+  workers partitioned by endpoint instead, see `Matterlix.Matter.Dispatcher`.
+
+  ## Logging
+
+  The Matter SDK logs to stdout. The `:log` option keeps its output in an
+  in-memory ring in the NIF instead and forwards it to `Logger` in batches,
+  with per-module levels and an optional crash file, see
+  `Matterlix.Matter.LogDrain`.
+
+  ## Hot upgrades
+
+  A release upgrade that changes this module or the handler keeps this
+  process, its NIF context and the running server; `code_change/3` only
+  fills in state added by the new version. A new version of
+  `Matterlix.Matter.NIF` takes the running server over too, see its
+  "Hot upgrades" section.
+
+  When the process itself has to be restarted, `detach/1` first leaves the
+  server running: the next server process started reattaches to it, with
+  its fabrics, sessions and subscriptions, instead of starting another and
+  making every controller rediscover the device.
   """
 
   use GenServer
   require Logger
 
   # Suppress warnings for modules only available on Nerves targets
-  @compile {:no_warn_undefined, [VintageNet, VintageNetWiFi]}
+  @compile {:no_warn_undefined, [VintageNet, VintageNetWiFi, :telemetry]}
 
+  alias Matterlix.Matter.Dispatcher
+  alias Matterlix.Matter.LogDrain
   alias Matterlix.Matter.NIF
+  alias Matterlix.Matter.OTA
+  alias Matterlix.Matter.WiFiScan
 
   # WiFi commissioning configuration
   @wifi_interface "wlan0"
   @wifi_connect_timeout 30_000
-
-  defstruct [:context, :started, :pending_wifi_connect, :handler]
+  # How long a scan may take before the access points seen so far are reported
+  @wifi_scan_timeout 10_000
+
+  # Where `verifier_cache: true` keeps the SPAKE2+ verifier
+  @default_verifier_cache "/data/matter_spake2p_verifier.bin"
+
+  # Where `storage: true` keeps the coalescing key-value store
+  @default_storage_path "/data/matter_kvs.bin"
+
+  defstruct [
+    :context,
+    :name,
+    :started,
+    :pending_wifi_connect,
+    :handler,
+    pending_wifi_scan: nil,
+    detached: false,
+    starting: false,
+    start_waiters: [],
+    start_began: nil,
+    pending_replies: %{},
+    attribute_cache: nil,
+    dispatcher: nil,
+    log_drain: nil,
+    ota: nil,
+    write_transactions: %{}
+  ]
 
   @type t :: %__MODULE__{
           context: reference() | nil,
+          name: GenServer.name(),
           started: boolean(),
+          starting: boolean(),
+          start_waiters: [GenServer.from()],
+          start_began: integer() | nil,
           pending_wifi_connect: reference() | nil,
-          handler: module()
+          pending_wifi_scan: {binary() | nil, reference()} | nil,
+          detached: boolean(),
+          handler: module(),
+          pending_replies: %{reference() => {GenServer.from(), cache_update()}},
+          attribute_cache: %{table: :ets.tid(), volatile: [attribute_pattern()]} | nil,
+          dispatcher: Matterlix.Matter.Dispatcher.t() | nil,
+          log_drain: pid() | nil,
+          ota: pid() | nil,
+          write_transactions: %{reference() => pid()}
         }
 
+  @typep attribute_path :: {non_neg_integer(), non_neg_integer(), non_neg_integer()}
+  @typep attribute_pattern ::
+           {non_neg_integer() | :_, non_neg_integer() | :_, non_neg_integer() | :_}
+  @typep cache_update :: {:read, attribute_path()} | {:write, attribute_path(), term()}
+
   # Client API
 
   @doc """
@@ -63,23 +194,67 @@ defmodule Matterlix.Matter do
   ## Options
   - `:name` - Optional name to register the process
   - `:auto_start` - Whether to automatically start the Matter server (default: false)
+  - `:event_queue` - Deliver attribute changes in batches instead of one message per
+    change. A keyword list with `:capacity` (default: 1024), `:batch_size` (default: 64)
+    and `:interval` in milliseconds (default: 10). Disabled when not set.
+  - `:change_filter` - Initial attribute change filter, see `set_change_filter/2`
+  - `:coalesce` - Per-path coalescing rules, see `set_coalescing/2`. Enables the event
+    queue with default settings if `:event_queue` is not given.
+  - `:handler` - `Matterlix.Handler` module for this server (default: the `:handler`
+    application env, or `Matterlix.Handler.Default`)
+  - `:attribute_cache` - Serve `get_attribute/4` from an ETS cache, see
+    "Attribute cache". `true`, or a keyword list with `:volatile`, a list of
+    `{endpoint, cluster, attribute}` patterns (with `:_` wildcards) that are never cached.
+    Disabled when not set.
+  - `:dispatch` - Call the handler's `handle_attribute_change/5` from partitioned worker
+    processes instead of this server, see `Matterlix.Matter.Dispatcher` for the options
+    (`true` for the defaults). Inline when not set.
+  - `:report_intervals` - Per-cluster minimum reporting intervals, see
+    `set_report_intervals/2`
+  - `:storage` - Persist the server's fabrics, ACLs and counters through a write-coalescing
+    store on the data partition instead of the SDK's default KVS. `true` for
+    `#{@default_storage_path}`, or a keyword list with `:path`, `:flush_interval` in
+    milliseconds (default: 5000) and `:critical_prefixes`, see `NIF.nif_configure_storage/4`.
+    Takes effect at the next `start_server/1`. The default KVS when not set.
+  - `:ota` - Accept OTA software updates, streamed into fwup as they download, see
+    `Matterlix.Matter.OTA` for the options (`true` for the defaults). Events go to the
+    handler's optional `handle_ota_event/2`. Takes effect at the next `start_server/1`;
+    updates are refused when not set.
+  - `:log` - Forward Matter SDK logs to `Logger` through the NIF's log ring, see
+    `Matterlix.Matter.LogDrain` for the options (`true` for the defaults). The SDK
+    logs to stdout when not set.
   """
   @spec start_link(keyword()) :: GenServer.on_start()
   def start_link(opts \\ []) do
     {name, opts} = Keyword.pop(opts, :name, __MODULE__)
-    GenServer.start_link(__MODULE__, opts, name: name)
+    GenServer.start_link(__MODULE__, [{:name, name} | opts], name: name)
   end
 
   @doc """
   Initialize and start the Matter server.
 
   This makes the device discoverable and commissionable on the network.
+
+  Startup runs in the background: this returns `:ok` as soon as the start is
+  under way and the server keeps answering other calls meanwhile. Use
+  `await_started/2` to wait for the result.
   """
   @spec start_server(GenServer.server()) :: :ok | {:error, term()}
   def start_server(server) do
     GenServer.call(server, :start_server)
   end
 
+  @doc """
+  Wait until a start begun by `start_server/1` (or `:auto_start`) finishes.
+
+  Returns `:ok` once the server is running, `{:error, reason}` if startup
+  failed and `{:error, :not_started}` if no start is in progress.
+  """
+  @spec await_started(GenServer.server(), timeout()) :: :ok | {:error, term()}
+  def await_started(server, timeout \\ 30_000) do
+    GenServer.call(server, :await_started, timeout)
+  end
+
   @doc """
   Stop the Matter server.
   """
@@ -88,6 +263,20 @@ defmodule Matterlix.Matter do
     GenServer.call(server, :stop_server)
   end
 
+  @doc """
+  Leave the Matter server running when this process exits.
+
+  The server stops delivering events here, and the next `Matterlix.Matter`
+  to start takes it over already started: `start_server/1` then returns
+  `{:error, :already_started}` and `:auto_start` does nothing. Use before a
+  restart of this process during a deploy, so controllers never see the
+  device go away.
+  """
+  @spec detach(GenServer.server()) :: :ok | {:error, term()}
+  def detach(server) do
+    GenServer.call(server, :detach)
+  end
+
   @doc """
   Get information about the Matter device.
   """
@@ -96,6 +285,110 @@ defmodule Matterlix.Matter do
     GenServer.call(server, :get_info)
   end
 
+  @doc """
+  Get lifecycle timestamps, see `NIF.nif_get_timings/1`.
+
+  ## Example
+
+      {:ok, t} = Matterlix.Matter.timings(pid)
+      boot_to_advertised_ms = div(t.first_advertisement - t.load, 1000)
+  """
+  @spec timings(GenServer.server()) :: {:ok, %{atom() => integer()}} | {:error, term()}
+  def timings(server) do
+    GenServer.call(server, :timings)
+  end
+
+  @doc """
+  Get NIF runtime statistics, see `NIF.nif_get_stats/1`.
+
+  ## Example
+
+      {:ok, stats} = Matterlix.Matter.stats(pid)
+      stats.calls.nif_set_attribute_async
+  """
+  @spec stats(GenServer.server()) :: {:ok, map()} | {:error, term()}
+  def stats(server) do
+    GenServer.call(server, :stats)
+  end
+
+  @doc """
+  Get memory usage of the process, the NIF and the Matter stack, see
+  `NIF.nif_get_memory_stats/1`.
+
+  ## Example
+
+      {:ok, %{pools: pools, in_use: in_use}} = Matterlix.Matter.memory_stats(pid)
+      in_use.subscriptions / pools.subscriptions
+  """
+  @spec memory_stats(GenServer.server()) :: {:ok, map()} | {:error, term()}
+  def memory_stats(server) do
+    GenServer.call(server, :memory_stats)
+  end
+
+  @doc """
+  Get the state and counters of OTA software updates (see the `:ota` option),
+  see `NIF.nif_get_ota_stats/1`.
+
+  ## Example
+
+      {:ok, %{state: :downloading, offset: offset}} = Matterlix.Matter.ota_stats(pid)
+  """
+  @spec ota_stats(GenServer.server()) :: {:ok, map()} | {:error, term()}
+  def ota_stats(server) do
+    GenServer.call(server, :ota_stats)
+  end
+
+  @doc """
+  Get counters for the coalescing key-value store (see the `:storage` option),
+  see `NIF.nif_get_storage_stats/1`.
+
+  ## Example
+
+      {:ok, %{open: true, writes: writes, flushes: flushes}} = Matterlix.Matter.storage_stats(pid)
+  """
+  @spec storage_stats(GenServer.server()) :: {:ok, map()} | {:error, term()}
+  def storage_stats(server) do
+    GenServer.call(server, :storage_stats)
+  end
+
+  @doc """
+  Get counters for the log ring (see the `:log` option), see
+  `NIF.nif_get_log_stats/1`.
+
+  ## Example
+
+      {:ok, %{enabled: true, dropped: 0}} = Matterlix.Matter.log_stats(pid)
+  """
+  @spec log_stats(GenServer.server()) :: {:ok, map()} | {:error, term()}
+  def log_stats(server) do
+    GenServer.call(server, :log_stats)
+  end
+
+  @doc """
+  Change which Matter SDK log records are kept, see `NIF.nif_set_log_levels/3`.
+
+  ## Example
+
+      # Debug output of the data model only
+      :ok = Matterlix.Matter.set_log_levels(pid, :info, [{"DMG", :debug}])
+  """
+  @spec set_log_levels(GenServer.server(), NIF.log_level(), [{String.t(), NIF.log_level()}]) ::
+          :ok | {:error, term()}
+  def set_log_levels(server, level, modules \\ []) do
+    GenServer.call(server, {:set_log_levels, level, modules})
+  end
+
+  @doc """
+  Get queue depth metrics of the handler dispatcher, see
+  `Matterlix.Matter.Dispatcher.stats/1`.
+
+  Returns `{:error, :inline}` unless the server was started with `:dispatch`.
+  """
+  @spec dispatch_stats(GenServer.server()) :: {:ok, [map()]} | {:error, :inline}
+  def dispatch_stats(server) do
+    GenServer.call(server, :dispatch_stats)
+  end
+
   @doc """
   Set a Matter attribute value.
 
@@ -105,6 +398,10 @@ defmodule Matterlix.Matter do
   - `cluster_id` - The cluster ID
   - `attribute_id` - The attribute ID
   - `value` - The value to set
+
+  The write is queued on the Matter event loop with
+  `NIF.nif_set_attribute_async/5`, so it never ties up a dirty scheduler
+  while waiting for the CHIP stack lock.
   """
   @spec set_attribute(
           GenServer.server(),
@@ -118,13 +415,321 @@ defmodule Matterlix.Matter do
     GenServer.call(server, {:set_attribute, endpoint_id, cluster_id, attribute_id, value})
   end
 
+  @doc """
+  Set several Matter attribute values in one call.
+
+  The whole batch is applied under a single CHIP stack lock, so pushing a
+  sensor snapshot costs one round-trip instead of one per attribute.
+
+  Returns `{:ok, results}` with one `:ok` or `{:error, reason}` per entry.
+
+  ## Example
+
+      {:ok, [:ok, :ok]} =
+        Matterlix.Matter.set_attributes(pid, [
+          {1, 0x0402, 0x0000, 2350},
+          {1, 0x0405, 0x0000, 4500}
+        ])
+  """
+  @spec set_attributes(GenServer.server(), [NIF.attribute_write()]) ::
+          {:ok, [:ok | {:error, term()}]} | {:error, term()}
+  def set_attributes(server, attributes) when is_list(attributes) do
+    GenServer.call(server, {:set_attributes, attributes})
+  end
+
   @doc """
   Get a Matter attribute value.
+
+  Like `set_attribute/5`, the read runs on the Matter event loop. With the
+  attribute cache enabled, cached values are returned without calling the
+  server at all, see "Attribute cache".
   """
   @spec get_attribute(GenServer.server(), non_neg_integer(), non_neg_integer(), non_neg_integer()) ::
           {:ok, term()} | {:error, term()}
   def get_attribute(server, endpoint_id, cluster_id, attribute_id) do
-    GenServer.call(server, {:get_attribute, endpoint_id, cluster_id, attribute_id})
+    case cache_lookup(server, {endpoint_id, cluster_id, attribute_id}) do
+      {:ok, _value} = hit -> hit
+      :miss -> GenServer.call(server, {:get_attribute, endpoint_id, cluster_id, attribute_id})
+    end
+  end
+
+  @doc """
+  Resolve an attribute path into a reusable handle.
+
+  Pass the handle to `set_attribute/3` and `get_attribute/2` for attributes
+  that are written or read frequently. After a server restart the handle
+  becomes stale (`{:error, :stale_handle}`) and must be resolved again.
+
+  ## Example
+
+      {:ok, level} = Matterlix.Matter.resolve_attribute(pid, 1, 0x0008, 0x0000)
+      :ok = Matterlix.Matter.set_attribute(pid, level, 128)
+  """
+  @spec resolve_attribute(
+          GenServer.server(),
+          non_neg_integer(),
+          non_neg_integer(),
+          non_neg_integer()
+        ) ::
+          {:ok, reference()} | {:error, term()}
+  def resolve_attribute(server, endpoint_id, cluster_id, attribute_id) do
+    GenServer.call(server, {:resolve_attribute, endpoint_id, cluster_id, attribute_id})
+  end
+
+  @doc """
+  Set a Matter attribute value through a handle from `resolve_attribute/4`.
+  """
+  @spec set_attribute(GenServer.server(), reference(), term()) :: :ok | {:error, term()}
+  def set_attribute(server, handle, value) do
+    GenServer.call(server, {:set_attribute_h, handle, value})
+  end
+
+  @doc """
+  Get a Matter attribute value through a handle from `resolve_attribute/4`.
+  """
+  @spec get_attribute(GenServer.server(), reference()) :: {:ok, term()} | {:error, term()}
+  def get_attribute(server, handle) do
+    GenServer.call(server, {:get_attribute_h, handle})
+  end
+
+  @doc """
+  Read every attribute of a cluster on an endpoint in one call.
+
+  Returns a consistent snapshot as a map of attribute ID to value.
+
+  ## Example
+
+      # Snapshot the Level Control cluster of endpoint 1
+      {:ok, %{0x0000 => level}} = Matterlix.Matter.read_cluster(pid, 1, 0x0008)
+  """
+  @spec read_cluster(GenServer.server(), non_neg_integer(), non_neg_integer()) ::
+          {:ok, %{non_neg_integer() => term()}} | {:error, term()}
+  def read_cluster(server, endpoint_id, cluster_id) do
+    GenServer.call(server, {:read_cluster, endpoint_id, cluster_id})
+  end
+
+  @doc """
+  Filter which attribute changes are delivered to the handler.
+
+  Filtering happens in the NIF before any message is built, so ignored
+  changes cost the Matter thread almost nothing and never reach this process.
+  Pass `nil` to deliver every change again.
+
+  ## Example
+
+      # Only On/Off and Level Control changes on endpoint 1
+      :ok =
+        Matterlix.Matter.set_change_filter(pid, {:allow, [{1, 0x0006, :_}, {1, 0x0008, :_}]})
+
+      # Everything except Identify and diagnostics clusters
+      :ok =
+        Matterlix.Matter.set_change_filter(pid, {:deny, [{:_, 0x0003, :_}, {:_, 0x0033, :_}]})
+  """
+  @spec set_change_filter(GenServer.server(), {:allow | :deny, [NIF.change_pattern()]} | nil) ::
+          :ok | {:error, term()}
+  def set_change_filter(server, filter) do
+    GenServer.call(server, {:set_change_filter, filter})
+  end
+
+  @doc """
+  Receive attribute changes in the calling process as well as the handler.
+
+  The caller gets the raw NIF messages: `{:attribute_changed, endpoint_id,
+  cluster_id, attribute_id, type, value}`, or with the event queue enabled
+  `{:attribute_changes, [{endpoint_id, cluster_id, attribute_id, type,
+  value}]}` batches. `filter` selects the changes this subscriber sees and
+  takes the same form as in `set_change_filter/2`, which does not affect
+  subscribers. Subscribing again replaces the filter.
+
+  The NIF builds each change once and sends a copy to every subscriber, so
+  several consumers (UI, cloud sync, logging) need no relay process. The
+  subscription ends when the caller exits; up to 32 processes can subscribe.
+
+  ## Example
+
+      :ok = Matterlix.Matter.subscribe(pid, {:allow, [{:_, 0x0006, :_}]})
+
+      receive do
+        {:attribute_changed, endpoint_id, 0x0006, 0x0000, _type, on?} -> ...
+      end
+  """
+  @spec subscribe(GenServer.server(), {:allow | :deny, [NIF.change_pattern()]} | nil) ::
+          :ok | {:error, term()}
+  def subscribe(server, filter \\ nil) do
+    GenServer.call(server, {:subscribe, self(), filter})
+  end
+
+  @doc """
+  Stop receiving attribute changes in the calling process.
+  """
+  @spec unsubscribe(GenServer.server()) :: :ok | {:error, term()}
+  def unsubscribe(server) do
+    GenServer.call(server, {:unsubscribe, self()})
+  end
+
+  @doc """
+  List the processes subscribed with `subscribe/2`.
+  """
+  @spec subscribers(GenServer.server()) :: {:ok, [pid()]} | {:error, term()}
+  def subscribers(server) do
+    GenServer.call(server, :subscribers)
+  end
+
+  @doc """
+  Coalesce rapid attribute changes so the handler only sees the latest values.
+
+  Each rule is `{pattern, min_interval_ms}`. A path matching a pattern is
+  delivered to the handler at most once per interval; intermediate values
+  are dropped, and the final value of a burst (e.g. the end of a Level
+  Control transition) is always delivered once the interval has passed.
+  Pass `[]` to remove all rules.
+
+  Coalescing requires the event queue (see the `:event_queue` option).
+
+  ## Example
+
+      :ok =
+        Matterlix.Matter.set_coalescing(pid, [
+          {{:_, 0x0008, 0x0000}, 100},
+          {{:_, 0x0300, :_}, 100}
+        ])
+  """
+  @spec set_coalescing(GenServer.server(), [{NIF.change_pattern(), pos_integer()}]) ::
+          :ok | {:error, term()}
+  def set_coalescing(server, rules) when is_list(rules) do
+    GenServer.call(server, {:set_coalescing, rules})
+  end
+
+  @doc """
+  Run `fun` as a write transaction and return its result.
+
+  Writes made while `fun` runs, through this server or
+  `Matterlix.Matter.Direct`, update attribute storage right away but are
+  marked for subscription reports only when `fun` returns, so controllers
+  get one report for the whole burst. See `NIF.nif_begin_writes/1`. If the
+  caller exits before `fun` returns, the server commits for it.
+
+  Returns `{:error, reason}` without calling `fun` if the transaction
+  cannot be opened (with the SDK, before the server has started).
+
+  ## Example
+
+      Matterlix.Matter.write_transaction(pid, fn ->
+        Matterlix.Matter.set_attributes(pid, [
+          {1, 0x0402, 0x0000, 2150},
+          {1, 0x0405, 0x0000, 4800}
+        ])
+      end)
+  """
+  @spec write_transaction(GenServer.server(), (-> result)) :: result | {:error, term()}
+        when result: term()
+  def write_transaction(server, fun) when is_function(fun, 0) do
+    case GenServer.call(server, :begin_writes) do
+      {:ok, ref} ->
+        try do
+          fun.()
+        after
+          GenServer.call(server, {:commit_writes, ref})
+        end
+
+      {:error, _} = error ->
+        error
+    end
+  end
+
+  @doc """
+  Set per-cluster minimum reporting intervals, `[{cluster_id, min_interval_ms}]`.
+
+  Writes to a cluster that was reported less than its interval ago are held
+  and reported together when it ends. See `NIF.nif_set_report_intervals/2`.
+  """
+  @spec set_report_intervals(GenServer.server(), [{non_neg_integer(), pos_integer()}]) ::
+          :ok | {:error, term()}
+  def set_report_intervals(server, intervals) when is_list(intervals) do
+    GenServer.call(server, {:set_report_intervals, intervals})
+  end
+
+  @doc """
+  Get write transaction and report deferral counters, see `NIF.nif_get_report_stats/1`.
+  """
+  @spec report_stats(GenServer.server()) :: {:ok, map()} | {:error, term()}
+  def report_stats(server) do
+    GenServer.call(server, :report_stats)
+  end
+
+  @doc """
+  Get counters for the batched attribute change queue (see the `:event_queue` option).
+
+  ## Example
+
+      {:ok, %{enabled: true, overflow: 0}} = Matterlix.Matter.event_queue_stats(pid)
+  """
+  @spec event_queue_stats(GenServer.server()) :: {:ok, map()} | {:error, term()}
+  def event_queue_stats(server) do
+    GenServer.call(server, :event_queue_stats)
+  end
+
+  @doc """
+  Preallocate room for `capacity` bridged endpoints, numbered from
+  `first_endpoint_id` (default: 2, after the aggregator on endpoint 1).
+
+  With the SDK the server must be started and the device built from a
+  profile with dynamic endpoints (`:bridge`). See "Bridged devices".
+  """
+  @spec configure_bridge(GenServer.server(), non_neg_integer(), non_neg_integer()) ::
+          :ok | {:error, term()}
+  def configure_bridge(server, capacity, first_endpoint_id \\ 2) do
+    GenServer.call(server, {:configure_bridge, capacity, first_endpoint_id})
+  end
+
+  @doc """
+  Bridge a `{kind, label, unique_id}` device under `parent_endpoint_id`
+  (default: the aggregator on endpoint 1), see `NIF.nif_add_bridged_endpoint/3`.
+
+  ## Example
+
+      {:ok, endpoint_id} =
+        Matterlix.Matter.add_bridged_endpoint(pid, {:on_off_light, "Porch", "zb-00124b0001"})
+  """
+  @spec add_bridged_endpoint(GenServer.server(), NIF.bridged_device(), non_neg_integer()) ::
+          {:ok, non_neg_integer()} | {:error, term()}
+  def add_bridged_endpoint(server, device, parent_endpoint_id \\ 1) do
+    GenServer.call(server, {:add_bridged_endpoint, device, parent_endpoint_id})
+  end
+
+  @doc """
+  Bridge several devices at once, see `NIF.nif_add_bridged_endpoints/3`.
+  """
+  @spec add_bridged_endpoints(GenServer.server(), [NIF.bridged_device()], non_neg_integer()) ::
+          {:ok, [{:ok, non_neg_integer()} | {:error, term()}]} | {:error, term()}
+  def add_bridged_endpoints(server, devices, parent_endpoint_id \\ 1) when is_list(devices) do
+    GenServer.call(server, {:add_bridged_endpoints, devices, parent_endpoint_id})
+  end
+
+  @doc """
+  Remove a bridged endpoint.
+  """
+  @spec remove_bridged_endpoint(GenServer.server(), non_neg_integer()) :: :ok | {:error, term()}
+  def remove_bridged_endpoint(server, endpoint_id) do
+    GenServer.call(server, {:remove_bridged_endpoint, endpoint_id})
+  end
+
+  @doc """
+  Remove several bridged endpoints at once, see `NIF.nif_remove_bridged_endpoints/2`.
+  """
+  @spec remove_bridged_endpoints(GenServer.server(), [non_neg_integer()]) ::
+          {:ok, [:ok | {:error, term()}]} | {:error, term()}
+  def remove_bridged_endpoints(server, endpoint_ids) when is_list(endpoint_ids) do
+    GenServer.call(server, {:remove_bridged_endpoints, endpoint_ids})
+  end
+
+  @doc """
+  Get the size and counters of the bridged endpoint arena, see
+  `NIF.nif_get_bridge_stats/1`.
+  """
+  @spec bridge_stats(GenServer.server()) :: {:ok, %{atom() => integer()}} | {:error, term()}
+  def bridge_stats(server) do
+    GenServer.call(server, :bridge_stats)
   end
 
   @doc """
@@ -200,6 +805,10 @@ defmodule Matterlix.Matter do
   Must be called **before** `start_server/1` for the values to take effect.
   These values determine the pairing code you'll use to commission the device.
 
+  Set `config :matterlix, verifier_cache: true` (or a file path) to persist
+  the SPAKE2+ verifier derived from the PIN, so later boots skip the PBKDF2
+  derivation until the PIN changes.
+
   ## Parameters
   - `server` - The GenServer pid or name
   - `setup_pin` - The setup PIN code (8 digits, 1-99999998)
@@ -232,12 +841,35 @@ defmodule Matterlix.Matter do
   @impl true
   def init(opts) do
     auto_start = Keyword.get(opts, :auto_start, false)
-    handler = Application.get_env(:matterlix, :handler, Matterlix.Handler.Default)
+    handler =
+      Keyword.get_lazy(opts, :handler, fn ->
+        Application.get_env(:matterlix, :handler, Matterlix.Handler.Default)
+      end)
 
-    case NIF.nif_init() do
+    init_began = System.monotonic_time()
+    result = NIF.nif_init()
+
+    emit_telemetry([:init], %{duration: System.monotonic_time() - init_began}, %{
+      result: if(match?({:ok, _}, result), do: :ok, else: result)
+    })
+
+    case result do
       {:ok, context} ->
         # Register this process to receive Matter events from NIF
         NIF.nif_register_callback(context)
+        configure_event_queue(context, event_queue_opts(opts))
+
+        if filter = Keyword.get(opts, :change_filter) do
+          NIF.nif_set_change_filter(context, filter)
+        end
+
+        if rules = Keyword.get(opts, :coalesce) do
+          NIF.nif_set_coalescing(context, rules)
+        end
+
+        if intervals = Keyword.get(opts, :report_intervals) do
+          NIF.nif_set_report_intervals(context, intervals)
+        end
 
         # Apply commissioning config if set (setup_pin and discriminator)
         setup_pin = Application.get_env(:matterlix, :setup_pin)
@@ -251,19 +883,37 @@ defmodule Matterlix.Matter do
           NIF.nif_set_commissioning_info(context, setup_pin, discriminator)
         end
 
+        configure_verifier_cache(context, Application.get_env(:matterlix, :verifier_cache))
+        configure_storage(context, Keyword.get(opts, :storage))
+
         # Subscribe to WiFi connection status changes (on target only)
         if Code.ensure_loaded?(VintageNet) do
           VintageNet.subscribe(["interface", @wifi_interface, "connection"])
+          VintageNet.subscribe(["interface", @wifi_interface, "wifi", "access_points"])
+        end
+
+        # A server left running by an earlier process is taken over as is
+        reattached = reattached?(context)
+
+        if reattached do
+          Logger.info("Matter: Reattached to the running server")
         end
 
         state = %__MODULE__{
           context: context,
-          started: false,
+          name: Keyword.fetch!(opts, :name),
+          started: reattached,
           pending_wifi_connect: nil,
-          handler: handler
+          handler: handler,
+          attribute_cache: start_attribute_cache(opts),
+          dispatcher: start_dispatcher(handler, Keyword.get(opts, :dispatch)),
+          log_drain: start_log_drain(context, Keyword.get(opts, :log)),
+          ota: start_ota(context, handler, Keyword.get(opts, :ota))
         }
 
-        if auto_start do
+        publish(state)
+
+        if auto_start and not reattached do
           send(self(), :auto_start)
         end
 
@@ -276,10 +926,9 @@ defmodule Matterlix.Matter do
 
   @impl true
   def handle_info(:auto_start, state) do
-    case NIF.nif_start_server(state.context) do
+    case NIF.nif_start_server_async(state.context) do
       :ok ->
-        Logger.info("Matter server started automatically")
-        {:noreply, %{state | started: true}}
+        {:noreply, %{state | starting: true, start_began: System.monotonic_time()}}
 
       {:error, reason} ->
         Logger.error("Failed to auto-start Matter server: #{inspect(reason)}")
@@ -287,61 +936,112 @@ defmodule Matterlix.Matter do
     end
   end
 
-  # Handle add_network from Matter SDK - dispatch to handler if implemented
+  # Progress from the background start
   @impl true
-  def handle_info({:add_network, ssid, credentials}, state) do
-    Logger.info("Matter: Network credentials received for SSID: #{inspect(ssid)}")
-
-    if function_exported?(state.handler, :handle_network_added, 2) do
-      state.handler.handle_network_added(to_string(ssid), to_string(credentials))
-    end
+  def handle_info({:matter_start_phase, phase, elapsed_us}, state) do
+    Logger.debug("Matter: start phase #{phase} took #{div(elapsed_us, 1000)} ms")
 
+    duration = System.convert_time_unit(elapsed_us, :microsecond, :native)
+    emit_telemetry([:start, :phase], %{duration: duration}, %{phase: phase})
     {:noreply, state}
   end
 
-  # Handle attribute_changed from Matter SDK callback - dispatch to handler
   @impl true
-  def handle_info({:attribute_changed, endpoint_id, cluster_id, attribute_id, type, value}, state) do
-    case state.handler.handle_attribute_change(
-           endpoint_id,
-           cluster_id,
-           attribute_id,
-           type,
-           value
-         ) do
-      :ok ->
-        :ok
+  def handle_info({:matter_started, result}, state) do
+    case result do
+      :ok -> Logger.info("Matter server started")
+      {:error, reason} -> Logger.error("Failed to start Matter server: #{inspect(reason)}")
+    end
 
-      {:error, reason} ->
-        Logger.warning("Matter handler returned error: #{inspect(reason)}")
+    if state.start_began do
+      timings =
+        case NIF.nif_get_timings(state.context) do
+          {:ok, timings} -> timings
+          {:error, _} -> %{}
+        end
+
+      emit_telemetry(
+        [:start, :stop],
+        %{duration: System.monotonic_time() - state.start_began},
+        %{result: result, timings: timings}
+      )
+    end
+
+    Enum.each(state.start_waiters, &GenServer.reply(&1, result))
+
+    {:noreply,
+     %{state | started: result == :ok, starting: false, start_waiters: [], start_began: nil}}
+  end
+
+  # Handle add_network from Matter SDK - dispatch to handler if implemented
+  @impl true
+  def handle_info({:add_network, ssid, credentials}, state) do
+    Logger.info("Matter: Network credentials received for SSID: #{inspect(ssid)}")
+
+    if function_exported?(state.handler, :handle_network_added, 2) do
+      state.handler.handle_network_added(to_string(ssid), to_string(credentials))
     end
 
     {:noreply, state}
   end
 
+  # Handle attribute_changed from Matter SDK callback - dispatch to handler
+  @impl true
+  def handle_info({:attribute_changed, endpoint_id, cluster_id, attribute_id, type, value}, state) do
+    cache_put(state.attribute_cache, {endpoint_id, cluster_id, attribute_id}, value)
+    dispatch_attribute_change(state, {endpoint_id, cluster_id, attribute_id, type, value})
+    {:noreply, state}
+  end
+
+  # Handle a batch from the NIF event queue - dispatch each change in order
+  @impl true
+  def handle_info({:attribute_changes, changes}, state) do
+    cache_put_changes(state.attribute_cache, changes)
+    Enum.each(changes, &dispatch_attribute_change(state, &1))
+    {:noreply, state}
+  end
+
+  # Reply from an asynchronous NIF operation. WiFi results are queued without
+  # a waiting caller, so their replies have no entry and are dropped.
+  @impl true
+  def handle_info({:matter_reply, ref, result}, state) do
+    case Map.pop(state.pending_replies, ref) do
+      {nil, _} ->
+        {:noreply, state}
+
+      {{from, update}, pending_replies} ->
+        cache_reply(state.attribute_cache, update, result)
+        GenServer.reply(from, result)
+        {:noreply, %{state | pending_replies: pending_replies}}
+    end
+  end
+
   # Handle scan_networks request from Matter SDK
   @impl true
-  def handle_info({:scan_networks, _filter}, state) do
+  def handle_info({:scan_networks, filter}, state) do
     Logger.info("Matter: Network scan requested")
 
+    filter = if is_binary(filter), do: filter
+    state = cancel_pending_wifi_scan(state)
+
     if Code.ensure_loaded?(VintageNetWiFi) do
       case VintageNetWiFi.scan(@wifi_interface) do
         :ok ->
+          # Results arrive as an update of the access_points property
           Logger.debug("Matter: WiFi scan initiated")
-          # For now, immediately report scan complete with no results
-          # A full implementation would wait for scan results and parse them
-          NIF.nif_wifi_scan_result(state.context, 0)
+          timer_ref = Process.send_after(self(), :wifi_scan_timeout, @wifi_scan_timeout)
+          {:noreply, %{state | pending_wifi_scan: {filter, timer_ref}}}
 
         {:error, reason} ->
           Logger.error("Matter: Failed to initiate WiFi scan: #{inspect(reason)}")
-          NIF.nif_wifi_scan_result(state.context, 1)
+          NIF.nif_wifi_scan_result_async(state.context, 1)
+          {:noreply, state}
       end
     else
       Logger.info("Matter: VintageNet not available (host mode), simulating scan success")
-      NIF.nif_wifi_scan_result(state.context, 0)
+      NIF.nif_wifi_scan_result_async(state.context, 0, <<>>)
+      {:noreply, state}
     end
-
-    {:noreply, state}
   end
 
   # Handle connect_network from Matter SDK - trigger VintageNet WiFi connection
@@ -366,13 +1066,13 @@ defmodule Matterlix.Matter do
 
         {:error, reason} ->
           Logger.error("Matter: Failed to configure WiFi: #{inspect(reason)}")
-          NIF.nif_wifi_connect_result(state.context, 1)
+          NIF.nif_wifi_connect_result_async(state.context, 1)
           {:noreply, state}
       end
     else
       # Host mode - simulate success
       Logger.info("Matter: VintageNet not available (host mode), simulating success")
-      NIF.nif_wifi_connect_result(state.context, 0)
+      NIF.nif_wifi_connect_result_async(state.context, 0)
       {:noreply, state}
     end
   end
@@ -388,14 +1088,14 @@ defmodule Matterlix.Matter do
         # Connected to internet - success!
         Process.cancel_timer(timer_ref)
         Logger.info("Matter: WiFi connected successfully (internet)")
-        NIF.nif_wifi_connect_result(state.context, 0)
+        NIF.nif_wifi_connect_result_async(state.context, 0)
         {:noreply, %{state | pending_wifi_connect: nil}}
 
       {:lan, timer_ref} when timer_ref != nil ->
         # Connected to LAN - also success for Matter commissioning
         Process.cancel_timer(timer_ref)
         Logger.info("Matter: WiFi connected successfully (LAN)")
-        NIF.nif_wifi_connect_result(state.context, 0)
+        NIF.nif_wifi_connect_result_async(state.context, 0)
         {:noreply, %{state | pending_wifi_connect: nil}}
 
       {:disconnected, _} ->
@@ -407,17 +1107,47 @@ defmodule Matterlix.Matter do
     end
   end
 
+  # Handle scan results from VintageNet
+  @impl true
+  def handle_info(
+        {VintageNet, ["interface", @wifi_interface, "wifi", "access_points"], _old, new, _meta},
+        %{pending_wifi_scan: {filter, timer_ref}} = state
+      ) do
+    Process.cancel_timer(timer_ref)
+    {:noreply, report_wifi_scan(%{state | pending_wifi_scan: nil}, filter, new)}
+  end
+
+  # The scan did not refresh the list in time: report what VintageNet already knows
+  @impl true
+  def handle_info(:wifi_scan_timeout, %{pending_wifi_scan: {filter, _timer_ref}} = state) do
+    Logger.warning("Matter: WiFi scan timeout, reporting known access points")
+    access_points = VintageNet.get(["interface", @wifi_interface, "wifi", "access_points"], [])
+    {:noreply, report_wifi_scan(%{state | pending_wifi_scan: nil}, filter, access_points)}
+  end
+
+  def handle_info(:wifi_scan_timeout, state) do
+    {:noreply, state}
+  end
+
   # Handle connection timeout
   @impl true
   def handle_info(:wifi_connect_timeout, state) do
     if state.pending_wifi_connect do
       Logger.error("Matter: WiFi connection timeout")
-      NIF.nif_wifi_connect_result(state.context, 1)
+      NIF.nif_wifi_connect_result_async(state.context, 1)
     end
 
     {:noreply, %{state | pending_wifi_connect: nil}}
   end
 
+  # A write transaction's owner died before committing: flush its deferred reports
+  @impl true
+  def handle_info({:DOWN, ref, :process, _pid, _reason}, state)
+      when is_map_key(state.write_transactions, ref) do
+    NIF.nif_commit_writes(state.context)
+    {:noreply, %{state | write_transactions: Map.delete(state.write_transactions, ref)}}
+  end
+
   # Catch-all for other VintageNet messages
   @impl true
   def handle_info({VintageNet, _property, _old, _new, _meta}, state) do
@@ -429,18 +1159,35 @@ defmodule Matterlix.Matter do
     {:reply, {:error, :already_started}, state}
   end
 
-  def handle_call(:start_server, _from, state) do
-    case NIF.nif_start_server(state.context) do
-      :ok ->
-        Logger.info("Matter server started")
-        {:reply, :ok, %{state | started: true}}
+  def handle_call(:start_server, _from, %{starting: true} = state) do
+    {:reply, {:error, :already_started}, state}
+  end
 
-      {:error, _} = error ->
-        {:reply, error, state}
+  def handle_call(:start_server, _from, state) do
+    case NIF.nif_start_server_async(state.context) do
+      :ok -> {:reply, :ok, %{state | starting: true, start_began: System.monotonic_time()}}
+      {:error, _} = error -> {:reply, error, state}
     end
   end
 
   @impl true
+  def handle_call(:await_started, _from, %{started: true} = state) do
+    {:reply, :ok, state}
+  end
+
+  def handle_call(:await_started, from, %{starting: true} = state) do
+    {:noreply, %{state | start_waiters: [from | state.start_waiters]}}
+  end
+
+  def handle_call(:await_started, _from, state) do
+    {:reply, {:error, :not_started}, state}
+  end
+
+  @impl true
+  def handle_call(:stop_server, _from, %{starting: true} = state) do
+    {:reply, {:error, :starting}, state}
+  end
+
   def handle_call(:stop_server, _from, %{started: false} = state) do
     {:reply, {:error, :not_started}, state}
   end
@@ -449,6 +1196,7 @@ defmodule Matterlix.Matter do
     case NIF.nif_stop_server(state.context) do
       :ok ->
         Logger.info("Matter server stopped")
+        cache_clear(state.attribute_cache)
         {:reply, :ok, %{state | started: false}}
 
       {:error, _} = error ->
@@ -456,6 +1204,11 @@ defmodule Matterlix.Matter do
     end
   end
 
+  @impl true
+  def handle_call(:detach, _from, state) do
+    {:reply, NIF.nif_detach(state.context), %{state | detached: true}}
+  end
+
   @impl true
   def handle_call(:get_info, _from, state) do
     result = NIF.nif_get_info(state.context)
@@ -463,17 +1216,208 @@ defmodule Matterlix.Matter do
   end
 
   @impl true
-  def handle_call({:set_attribute, endpoint_id, cluster_id, attribute_id, value}, _from, state) do
-    result = NIF.nif_set_attribute(state.context, endpoint_id, cluster_id, attribute_id, value)
+  def handle_call(:timings, _from, state) do
+    {:reply, NIF.nif_get_timings(state.context), state}
+  end
+
+  @impl true
+  def handle_call(:stats, _from, state) do
+    {:reply, NIF.nif_get_stats(state.context), state}
+  end
+
+  @impl true
+  def handle_call(:memory_stats, _from, state) do
+    {:reply, NIF.nif_get_memory_stats(state.context), state}
+  end
+
+  @impl true
+  def handle_call(:ota_stats, _from, state) do
+    {:reply, NIF.nif_get_ota_stats(state.context), state}
+  end
+
+  @impl true
+  def handle_call(:storage_stats, _from, state) do
+    {:reply, NIF.nif_get_storage_stats(state.context), state}
+  end
+
+  @impl true
+  def handle_call(:log_stats, _from, state) do
+    {:reply, NIF.nif_get_log_stats(state.context), state}
+  end
+
+  @impl true
+  def handle_call({:set_log_levels, level, modules}, _from, state) do
+    {:reply, NIF.nif_set_log_levels(state.context, level, modules), state}
+  end
+
+  @impl true
+  def handle_call(:dispatch_stats, _from, %{dispatcher: nil} = state) do
+    {:reply, {:error, :inline}, state}
+  end
+
+  def handle_call(:dispatch_stats, _from, state) do
+    {:reply, {:ok, Dispatcher.stats(state.dispatcher)}, state}
+  end
+
+  # Attribute reads and writes run on the Matter event loop; the caller is
+  # answered when the matching {:matter_reply, ref, result} arrives
+  @impl true
+  def handle_call({:set_attribute, endpoint_id, cluster_id, attribute_id, value}, from, state) do
+    state.context
+    |> NIF.nif_set_attribute_async(endpoint_id, cluster_id, attribute_id, value)
+    |> await_reply(from, {:write, {endpoint_id, cluster_id, attribute_id}, value}, state)
+  end
+
+  @impl true
+  def handle_call({:set_attributes, attributes}, _from, state) do
+    result = NIF.nif_set_attributes(state.context, attributes)
+
+    with {:ok, results} <- result do
+      cache_replies(state.attribute_cache, attributes, results)
+    end
+
+    {:reply, result, state}
+  end
+
+  @impl true
+  def handle_call({:get_attribute, endpoint_id, cluster_id, attribute_id}, from, state) do
+    state.context
+    |> NIF.nif_get_attribute_async(endpoint_id, cluster_id, attribute_id)
+    |> await_reply(from, {:read, {endpoint_id, cluster_id, attribute_id}}, state)
+  end
+
+  @impl true
+  def handle_call({:resolve_attribute, endpoint_id, cluster_id, attribute_id}, _from, state) do
+    result = NIF.nif_resolve_attribute(state.context, endpoint_id, cluster_id, attribute_id)
+    {:reply, result, state}
+  end
+
+  @impl true
+  def handle_call({:set_attribute_h, handle, value}, _from, state) do
+    result = NIF.nif_set_attribute_h(state.context, handle, value)
+    {:reply, result, state}
+  end
+
+  @impl true
+  def handle_call({:get_attribute_h, handle}, _from, state) do
+    result = NIF.nif_get_attribute_h(state.context, handle)
+    {:reply, result, state}
+  end
+
+  @impl true
+  def handle_call({:read_cluster, endpoint_id, cluster_id}, _from, state) do
+    result = NIF.nif_read_cluster(state.context, endpoint_id, cluster_id)
+    {:reply, result, state}
+  end
+
+  @impl true
+  def handle_call({:set_change_filter, filter}, _from, state) do
+    result = NIF.nif_set_change_filter(state.context, filter)
+    {:reply, result, state}
+  end
+
+  @impl true
+  def handle_call({:subscribe, pid, filter}, _from, state) do
+    {:reply, NIF.nif_subscribe(state.context, pid, filter), state}
+  end
+
+  @impl true
+  def handle_call({:unsubscribe, pid}, _from, state) do
+    {:reply, NIF.nif_unsubscribe(state.context, pid), state}
+  end
+
+  @impl true
+  def handle_call(:subscribers, _from, state) do
+    {:reply, NIF.nif_get_subscribers(state.context), state}
+  end
+
+  @impl true
+  def handle_call({:set_coalescing, rules}, _from, state) do
+    result = NIF.nif_set_coalescing(state.context, rules)
+    {:reply, result, state}
+  end
+
+  # The caller is monitored so that a transaction it leaves open is
+  # committed when it exits
+  @impl true
+  def handle_call(:begin_writes, {pid, _tag}, state) do
+    case NIF.nif_begin_writes(state.context) do
+      :ok ->
+        ref = Process.monitor(pid)
+        {:reply, {:ok, ref}, put_in(state.write_transactions[ref], pid)}
+
+      {:error, _} = error ->
+        {:reply, error, state}
+    end
+  end
+
+  @impl true
+  def handle_call({:commit_writes, ref}, _from, state) do
+    case Map.pop(state.write_transactions, ref) do
+      {nil, _} ->
+        {:reply, {:error, :no_transaction}, state}
+
+      {_pid, transactions} ->
+        Process.demonitor(ref, [:flush])
+        result = NIF.nif_commit_writes(state.context)
+        {:reply, result, %{state | write_transactions: transactions}}
+    end
+  end
+
+  @impl true
+  def handle_call({:set_report_intervals, intervals}, _from, state) do
+    result = NIF.nif_set_report_intervals(state.context, intervals)
+    {:reply, result, state}
+  end
+
+  @impl true
+  def handle_call(:report_stats, _from, state) do
+    {:reply, NIF.nif_get_report_stats(state.context), state}
+  end
+
+  @impl true
+  def handle_call(:event_queue_stats, _from, state) do
+    result = NIF.nif_get_event_queue_stats(state.context)
+    {:reply, result, state}
+  end
+
+  @impl true
+  def handle_call({:configure_bridge, capacity, first_endpoint_id}, _from, state) do
+    result = NIF.nif_configure_bridge(state.context, capacity, first_endpoint_id)
+    {:reply, result, state}
+  end
+
+  @impl true
+  def handle_call({:add_bridged_endpoint, device, parent_endpoint_id}, _from, state) do
+    result = NIF.nif_add_bridged_endpoint(state.context, parent_endpoint_id, device)
+    {:reply, result, state}
+  end
+
+  @impl true
+  def handle_call({:add_bridged_endpoints, devices, parent_endpoint_id}, _from, state) do
+    result = NIF.nif_add_bridged_endpoints(state.context, parent_endpoint_id, devices)
     {:reply, result, state}
   end
 
   @impl true
-  def handle_call({:get_attribute, endpoint_id, cluster_id, attribute_id}, _from, state) do
-    result = NIF.nif_get_attribute(state.context, endpoint_id, cluster_id, attribute_id)
+  def handle_call({:remove_bridged_endpoint, endpoint_id}, _from, state) do
+    result = NIF.nif_remove_bridged_endpoint(state.context, endpoint_id)
+    cache_drop_endpoints(state.attribute_cache, [endpoint_id])
     {:reply, result, state}
   end
 
+  @impl true
+  def handle_call({:remove_bridged_endpoints, endpoint_ids}, _from, state) do
+    result = NIF.nif_remove_bridged_endpoints(state.context, endpoint_ids)
+    cache_drop_endpoints(state.attribute_cache, endpoint_ids)
+    {:reply, result, state}
+  end
+
+  @impl true
+  def handle_call(:bridge_stats, _from, state) do
+    {:reply, NIF.nif_get_bridge_stats(state.context), state}
+  end
+
   @impl true
   def handle_call({:open_commissioning_window, timeout_seconds}, _from, state) do
     result = NIF.nif_open_commissioning_window(state.context, timeout_seconds)
@@ -489,6 +1433,7 @@ defmodule Matterlix.Matter do
   @impl true
   def handle_call(:factory_reset, _from, state) do
     result = NIF.nif_factory_reset(state.context)
+    cache_clear(state.attribute_cache)
     {:reply, result, state}
   end
 
@@ -511,15 +1456,335 @@ defmodule Matterlix.Matter do
 
   @impl true
   def terminate(_reason, state) do
-    if state.started do
+    # Transactions left open would defer reports for good
+    Enum.each(state.write_transactions, fn _ -> NIF.nif_commit_writes(state.context) end)
+
+    if state.started and not state.detached do
       NIF.nif_stop_server(state.context)
     end
 
+    if state.dispatcher do
+      Dispatcher.stop(state.dispatcher)
+    end
+
+    if state.log_drain do
+      LogDrain.stop(state.context, state.log_drain)
+    end
+
+    if state.ota do
+      OTA.stop(state.context, state.ota)
+    end
+
+    unpublish(state)
     :ok
   end
 
+  # The process, its context and the server carry on across the upgrade;
+  # fields added by the new version take their defaults
+  @impl true
+  def code_change(_old_vsn, state, _extra) do
+    {:ok, struct(__MODULE__, Map.from_struct(state))}
+  end
+
   # Private helpers
 
+  # Registering the callback made this context the owner, if the server's
+  # previous one is gone
+  defp reattached?(context) do
+    case NIF.nif_get_info(context) do
+      {:ok, %{is_owner: true, server_started: true}} -> true
+      _ -> false
+    end
+  end
+
+  # Coalescing is done by the event queue, so asking for it implies the queue
+  defp event_queue_opts(opts) do
+    case Keyword.fetch(opts, :event_queue) do
+      {:ok, queue_opts} -> queue_opts
+      :error -> if Keyword.has_key?(opts, :coalesce), do: [], else: nil
+    end
+  end
+
+  defp configure_event_queue(_context, nil), do: :ok
+
+  defp configure_event_queue(context, opts) do
+    capacity = Keyword.get(opts, :capacity, 1024)
+    batch_size = Keyword.get(opts, :batch_size, 64)
+    interval = Keyword.get(opts, :interval, 10)
+
+    case NIF.nif_configure_event_queue(context, capacity, batch_size, interval) do
+      :ok ->
+        :ok
+
+      {:error, reason} ->
+        Logger.error("Matter: Failed to configure event queue: #{inspect(reason)}")
+    end
+  end
+
+  # :telemetry is an optional dependency of the host application
+  defp emit_telemetry(event, measurements, metadata) do
+    if Code.ensure_loaded?(:telemetry) do
+      :telemetry.execute([:matterlix | event], measurements, metadata)
+    end
+
+    :ok
+  end
+
+  defp configure_verifier_cache(_context, cache) when cache in [nil, false], do: :ok
+
+  defp configure_verifier_cache(context, cache) do
+    path = if cache == true, do: @default_verifier_cache, else: cache
+    iterations = Application.get_env(:matterlix, :pbkdf_iterations, 1000)
+
+    case NIF.nif_set_verifier_cache(context, path, iterations) do
+      :ok ->
+        :ok
+
+      {:error, reason} ->
+        Logger.error("Matter: Failed to configure verifier cache: #{inspect(reason)}")
+    end
+  end
+
+  defp configure_storage(_context, storage) when storage in [nil, false], do: :ok
+
+  defp configure_storage(context, storage) do
+    opts = if storage == true, do: [], else: storage
+    path = Keyword.get(opts, :path, @default_storage_path)
+    interval = Keyword.get(opts, :flush_interval, 5000)
+    prefixes = Keyword.get(opts, :critical_prefixes)
+
+    case NIF.nif_configure_storage(context, path, interval, prefixes) do
+      :ok ->
+        :ok
+
+      {:error, reason} ->
+        Logger.error("Matter: Failed to configure storage: #{inspect(reason)}")
+    end
+  end
+
+  defp start_log_drain(_context, log) when log in [nil, false], do: nil
+
+  defp start_log_drain(context, log) do
+    case LogDrain.start_link(context, if(log == true, do: [], else: log)) do
+      {:ok, pid} ->
+        pid
+
+      {:error, reason} ->
+        Logger.error("Matter: Failed to configure the log ring: #{inspect(reason)}")
+        nil
+    end
+  end
+
+  defp start_ota(_context, _handler, ota) when ota in [nil, false], do: nil
+
+  defp start_ota(context, handler, ota) do
+    opts = if ota == true, do: [], else: ota
+
+    case OTA.start_link(context, Keyword.put_new(opts, :handler, handler)) do
+      {:ok, pid} ->
+        pid
+
+      {:error, reason} ->
+        Logger.error("Matter: Failed to set up OTA updates: #{inspect(reason)}")
+        nil
+    end
+  end
+
+  defp start_dispatcher(_handler, dispatch) when dispatch in [nil, false], do: nil
+  defp start_dispatcher(handler, dispatch) do
+    case Dispatcher.start_link(handler, if(dispatch == true, do: [], else: dispatch)) do
+      {:ok, dispatcher} ->
+        dispatcher
+
+      {:error, reason} ->
+        Logger.error("Matter: Failed to start the dispatcher: #{inspect(reason)}")
+        nil
+    end
+  end
+
+  defp dispatch_attribute_change(%{dispatcher: nil} = state, change) do
+    {endpoint_id, cluster_id, attribute_id, type, value} = change
+
+    case state.handler.handle_attribute_change(
+           endpoint_id,
+           cluster_id,
+           attribute_id,
+           type,
+           value
+         ) do
+      :ok ->
+        :ok
+
+      {:error, reason} ->
+        Logger.warning("Matter handler returned error: #{inspect(reason)}")
+    end
+  end
+
+  defp dispatch_attribute_change(state, change) do
+    Dispatcher.dispatch(state.dispatcher, change)
+  end
+
+  defp await_reply({:ok, ref}, from, update, state) do
+    pending_replies = Map.put(state.pending_replies, ref, {from, update})
+    {:noreply, %{state | pending_replies: pending_replies}}
+  end
+
+  defp await_reply({:error, _} = error, _from, _update, state), do: {:reply, error, state}
+
+  # Published context
+  #
+  # Clients find the NIF context and the cache table through :persistent_term
+  # under both the registered name and the pid, so cache hits and
+  # `Matterlix.Matter.Direct` calls cost no message. The entry is written once
+  # per server start and removed when the server terminates.
+
+  @doc false
+  @spec published(GenServer.server()) :: %{context: reference(), cache: :ets.tid() | nil} | nil
+  def published(server), do: :persistent_term.get(published_key(server), nil)
+
+  defp publish(state) do
+    cache = if state.attribute_cache, do: state.attribute_cache.table
+    published = %{context: state.context, cache: cache}
+
+    :persistent_term.put(published_key(state.name), published)
+    :persistent_term.put(published_key(self()), published)
+  end
+
+  defp unpublish(state) do
+    :persistent_term.erase(published_key(state.name))
+    :persistent_term.erase(published_key(self()))
+  end
+
+  defp published_key(server), do: {__MODULE__, :published, server}
+
+  # Attribute cache
+  #
+  # The table is protected: only this server writes it, any process reads it.
+
+  defp start_attribute_cache(opts) do
+    case Keyword.get(opts, :attribute_cache) do
+      cache when cache in [nil, false] ->
+        nil
+
+      cache ->
+        volatile = if cache == true, do: [], else: Keyword.get(cache, :volatile, [])
+        table = :ets.new(__MODULE__, [:set, :protected, read_concurrency: true])
+        %{table: table, volatile: volatile}
+    end
+  end
+
+  defp cache_lookup(server, path) do
+    case published(server) do
+      nil -> :miss
+      published -> lookup_cached(published, path)
+    end
+  end
+
+  # Runs in the caller. A table whose server has exited raises ArgumentError;
+  # the call that follows then reports the exit as usual.
+  defp lookup_cached(%{cache: nil}, _path), do: :miss
+
+  defp lookup_cached(%{cache: table}, path) do
+    case :ets.lookup(table, path) do
+      [{_path, value}] -> {:ok, value}
+      [] -> :miss
+    end
+  rescue
+    ArgumentError -> :miss
+  end
+
+  defp cache_put(nil, _path, _value), do: :ok
+
+  defp cache_put(cache, path, value) do
+    unless volatile?(cache.volatile, path), do: :ets.insert(cache.table, {path, value})
+    :ok
+  end
+
+  defp cache_put_changes(nil, _changes), do: :ok
+
+  defp cache_put_changes(cache, changes) do
+    entries =
+      for {endpoint_id, cluster_id, attribute_id, _type, value} <- changes,
+          path = {endpoint_id, cluster_id, attribute_id},
+          not volatile?(cache.volatile, path),
+          do: {path, value}
+
+    :ets.insert(cache.table, entries)
+    :ok
+  end
+
+  defp cache_reply(nil, _update, _result), do: :ok
+
+  # A reply can trail a change notification for the same attribute, from a
+  # `Matterlix.Matter.Direct` writer or the SDK, so it never replaces an
+  # entry: reads only fill a miss, and writes drop the entry for the next
+  # read to refill.
+  defp cache_reply(cache, {:read, path}, {:ok, value}) do
+    unless volatile?(cache.volatile, path), do: :ets.insert_new(cache.table, {path, value})
+    :ok
+  end
+
+  defp cache_reply(cache, {:write, path, _value}, :ok) do
+    :ets.delete(cache.table, path)
+    :ok
+  end
+
+  defp cache_reply(_cache, _update, _result), do: :ok
+
+  # Malformed batch entries only get their per-entry error back
+  defp cache_replies(nil, _attributes, _results), do: :ok
+
+  defp cache_replies(cache, attributes, results) do
+    Enum.zip_with(attributes, results, fn
+      {endpoint_id, cluster_id, attribute_id, value}, r ->
+        cache_reply(cache, {:write, {endpoint_id, cluster_id, attribute_id}, value}, r)
+
+      _entry, _r ->
+        :ok
+    end)
+
+    :ok
+  end
+
+  defp cache_clear(nil), do: :ok
+  defp cache_clear(cache), do: :ets.delete_all_objects(cache.table)
+
+  # A later bridged device may get the same endpoint ID
+  defp cache_drop_endpoints(nil, _endpoint_ids), do: :ok
+
+  defp cache_drop_endpoints(cache, endpoint_ids) do
+    Enum.each(endpoint_ids, &:ets.match_delete(cache.table, {{&1, :_, :_}, :_}))
+  end
+
+  defp volatile?(patterns, {endpoint_id, cluster_id, attribute_id}) do
+    Enum.any?(patterns, fn {ep, cl, at} ->
+      ep in [:_, endpoint_id] and cl in [:_, cluster_id] and at in [:_, attribute_id]
+    end)
+  end
+
+  defp report_wifi_scan(state, filter, access_points) do
+    results = WiFiScan.encode(access_points, filter)
+    Logger.debug("Matter: WiFi scan found #{length(access_points)} access points")
+
+    case NIF.nif_wifi_scan_result_async(state.context, 0, results) do
+      {:ok, _ref} ->
+        :ok
+
+      {:error, reason} ->
+        Logger.error("Matter: Failed to report WiFi scan: #{inspect(reason)}")
+        NIF.nif_wifi_scan_result_async(state.context, 1)
+    end
+
+    state
+  end
+
+  defp cancel_pending_wifi_scan(%{pending_wifi_scan: nil} = state), do: state
+
+  defp cancel_pending_wifi_scan(%{pending_wifi_scan: {_filter, timer_ref}} = state) do
+    Process.cancel_timer(timer_ref)
+    %{state | pending_wifi_scan: nil}
+  end
+
   defp cancel_pending_wifi_timer(%{pending_wifi_connect: nil} = state), do: state
 
   defp cancel_pending_wifi_timer(%{pending_wifi_connect: timer_ref} = state) do
@@ -0,0 +1,126 @@
+defmodule Matterlix.Matter.Direct do
+  @moduledoc """
+  Attribute I/O from the caller's process, without going through the
+  `Matterlix.Matter` GenServer.
+
+  `Matterlix.Matter` publishes its NIF context when it starts. The functions
+  here look it up and call the NIF directly, so reads and writes from many
+  processes run in parallel on the dirty I/O schedulers instead of queueing
+  behind one mailbox, WiFi commissioning and handler callbacks. The NIF
+  serializes access to the CHIP stack itself.
+
+  The GenServer still owns the lifecycle and receives the attribute change
+  notifications; writes made here reach its handler like any other change.
+  Reads here always go to the NIF, even with the attribute cache enabled (see
+  `Matterlix.Matter`): the cache only learns of these writes when their change
+  notification reaches the server, so it can trail a write made here.
+
+  Every function takes the server as its optional first argument
+  (default: `Matterlix.Matter`) and returns `{:error, :not_running}` if no
+  such server is running.
+
+  ## Example
+
+      :ok = Matterlix.Matter.Direct.set_attribute(1, 0x0402, 0x0000, 2350)
+      {:ok, 2350} = Matterlix.Matter.Direct.get_attribute(1, 0x0402, 0x0000)
+  """
+
+  alias Matterlix.Matter
+  alias Matterlix.Matter.NIF
+
+  @doc """
+  Set a Matter attribute value, see `NIF.nif_set_attribute/5`.
+  """
+  @spec set_attribute(
+          GenServer.server(),
+          non_neg_integer(),
+          non_neg_integer(),
+          non_neg_integer(),
+          term()
+        ) :: :ok | {:error, term()}
+  def set_attribute(server \\ Matter, endpoint_id, cluster_id, attribute_id, value) do
+    with {:ok, published} <- fetch(server) do
+      NIF.nif_set_attribute(published.context, endpoint_id, cluster_id, attribute_id, value)
+    end
+  end
+
+  @doc """
+  Set several attribute values under one CHIP stack lock, see
+  `NIF.nif_set_attributes/2`.
+  """
+  @spec set_attributes(GenServer.server(), [NIF.attribute_write()]) ::
+          {:ok, [:ok | {:error, term()}]} | {:error, term()}
+  def set_attributes(server \\ Matter, attributes) when is_list(attributes) do
+    with {:ok, published} <- fetch(server) do
+      NIF.nif_set_attributes(published.context, attributes)
+    end
+  end
+
+  @doc """
+  Get a Matter attribute value, see `NIF.nif_get_attribute/4`.
+  """
+  @spec get_attribute(
+          GenServer.server(),
+          non_neg_integer(),
+          non_neg_integer(),
+          non_neg_integer()
+        ) :: {:ok, term()} | {:error, term()}
+  def get_attribute(server \\ Matter, endpoint_id, cluster_id, attribute_id) do
+    with {:ok, published} <- fetch(server) do
+      NIF.nif_get_attribute(published.context, endpoint_id, cluster_id, attribute_id)
+    end
+  end
+
+  @doc """
+  Resolve an attribute path into a handle, see `Matterlix.Matter.resolve_attribute/4`.
+  """
+  @spec resolve_attribute(
+          GenServer.server(),
+          non_neg_integer(),
+          non_neg_integer(),
+          non_neg_integer()
+        ) :: {:ok, reference()} | {:error, term()}
+  def resolve_attribute(server \\ Matter, endpoint_id, cluster_id, attribute_id) do
+    with {:ok, published} <- fetch(server) do
+      NIF.nif_resolve_attribute(published.context, endpoint_id, cluster_id, attribute_id)
+    end
+  end
+
+  @doc """
+  Set an attribute value through a handle from `resolve_attribute/4`.
+  """
+  @spec set_attribute(GenServer.server(), reference(), term()) :: :ok | {:error, term()}
+  def set_attribute(server \\ Matter, handle, value) do
+    with {:ok, published} <- fetch(server) do
+      NIF.nif_set_attribute_h(published.context, handle, value)
+    end
+  end
+
+  @doc """
+  Get an attribute value through a handle from `resolve_attribute/4`.
+  """
+  @spec get_attribute(GenServer.server(), reference()) :: {:ok, term()} | {:error, term()}
+  def get_attribute(server \\ Matter, handle) do
+    with {:ok, published} <- fetch(server) do
+      NIF.nif_get_attribute_h(published.context, handle)
+    end
+  end
+
+  @doc """
+  Read every attribute of a cluster on an endpoint, see `NIF.nif_read_cluster/3`.
+  """
+  @spec read_cluster(GenServer.server(), non_neg_integer(), non_neg_integer()) ::
+          {:ok, %{non_neg_integer() => term()}} | {:error, term()}
+  def read_cluster(server \\ Matter, endpoint_id, cluster_id) do
+    with {:ok, published} <- fetch(server) do
+      NIF.nif_read_cluster(published.context, endpoint_id, cluster_id)
+    end
+  end
+
+  defp fetch(server) do
+    case Matter.published(server) do
+      nil -> {:error, :not_running}
+      published -> {:ok, published}
+    end
+  end
+end
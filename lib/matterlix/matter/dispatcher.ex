@@ -0,0 +1,205 @@
+defmodule Matterlix.Matter.Dispatcher do
+  @moduledoc """
+  Partitioned, asynchronous delivery of attribute changes to a
+  `Matterlix.Handler`.
+
+  By default `Matterlix.Matter` calls `handle_attribute_change/5` inline, so
+  a slow handler stalls every call to the server. With the `:dispatch`
+  option the server hands each change to one of a fixed set of worker
+  processes instead and moves on:
+
+      Matterlix.Matter.start_link(dispatch: [partitions: 4, key: :endpoint, max_queue: 256])
+
+  ## Options
+  - `:partitions` - number of workers (default: `System.schedulers_online()`)
+  - `:key` - what selects the worker: `:endpoint` (default), `:cluster`,
+    `:path` (the full `{endpoint, cluster, attribute}`) or a function of
+    `(endpoint_id, cluster_id, attribute_id)` returning any term
+  - `:max_queue` - changes a worker may have waiting (default: 1024)
+
+  Changes with the same key always go to the same worker and are handled in
+  the order they arrived. A worker whose queue is full sheds new changes for
+  its partition until it catches up; they are counted as `dropped`, and the
+  other partitions carry on. Handler errors and exceptions are logged and do
+  not stop the worker.
+
+  Workers exit with the server that started them.
+  """
+
+  require Logger
+
+  @enforce_keys [:handler, :workers, :counters, :key, :max_queue]
+  defstruct @enforce_keys
+
+  @type key ::
+          :endpoint
+          | :cluster
+          | :path
+          | (non_neg_integer(), non_neg_integer(), non_neg_integer() -> term())
+
+  @type t :: %__MODULE__{
+          handler: module(),
+          workers: tuple(),
+          counters: :counters.counters_ref(),
+          key: key(),
+          max_queue: pos_integer()
+        }
+
+  @type change ::
+          {non_neg_integer(), non_neg_integer(), non_neg_integer(), non_neg_integer(), term()}
+
+  # Per-partition counter slots
+  @depth 1
+  @high_water 2
+  @dispatched 3
+  @dropped 4
+  @slots 4
+
+  @doc """
+  Start the workers for `handler`, linked to and monitoring the caller.
+
+  Returns `{:error, :badarg}` unless `:partitions` and `:max_queue` are
+  positive integers.
+  """
+  @spec start_link(module(), keyword()) :: {:ok, t()} | {:error, :badarg}
+  def start_link(handler, opts \\ []) do
+    partitions = Keyword.get(opts, :partitions, System.schedulers_online())
+    max_queue = Keyword.get(opts, :max_queue, 1024)
+
+    if positive_integer?(partitions) and positive_integer?(max_queue) do
+      {:ok, start_workers(handler, partitions, max_queue, Keyword.get(opts, :key, :endpoint))}
+    else
+      {:error, :badarg}
+    end
+  end
+
+  defp start_workers(handler, partitions, max_queue, key) do
+    counters = :counters.new(partitions * @slots, [:write_concurrency])
+    owner = self()
+
+    workers =
+      for partition <- 0..(partitions - 1) do
+        spawn_link(fn -> worker_init(owner, handler, counters, partition) end)
+      end
+
+    %__MODULE__{
+      handler: handler,
+      workers: List.to_tuple(workers),
+      counters: counters,
+      key: key,
+      max_queue: max_queue
+    }
+  end
+
+  defp positive_integer?(value), do: is_integer(value) and value >= 1
+
+  @doc """
+  Queue a change on its partition's worker, or shed it if that queue is full.
+
+  Called by the process that started the dispatcher; it is the only one
+  that enqueues, so the depth check needs no lock.
+  """
+  @spec dispatch(t(), change()) :: :ok | :dropped
+  def dispatch(%__MODULE__{} = dispatcher, change) do
+    {endpoint_id, cluster_id, attribute_id, _type, _value} = change
+    partition = partition(dispatcher, endpoint_id, cluster_id, attribute_id)
+    base = partition * @slots
+    counters = dispatcher.counters
+
+    if :counters.get(counters, base + @depth) >= dispatcher.max_queue do
+      :counters.add(counters, base + @dropped, 1)
+      :dropped
+    else
+      :counters.add(counters, base + @depth, 1)
+      :counters.add(counters, base + @dispatched, 1)
+      depth = :counters.get(counters, base + @depth)
+
+      if depth > :counters.get(counters, base + @high_water) do
+        :counters.put(counters, base + @high_water, depth)
+      end
+
+      send(elem(dispatcher.workers, partition), {:attribute_change, change})
+      :ok
+    end
+  end
+
+  @doc """
+  Queue depth metrics, one map per partition in partition order.
+
+  - `:depth` - changes waiting or being handled right now
+  - `:high_water` - the largest depth seen
+  - `:dispatched` - changes queued since the dispatcher started
+  - `:dropped` - changes shed because the queue was full
+  """
+  @spec stats(t()) :: [%{atom() => non_neg_integer()}]
+  def stats(%__MODULE__{} = dispatcher) do
+    for partition <- 0..(tuple_size(dispatcher.workers) - 1) do
+      base = partition * @slots
+
+      %{
+        depth: :counters.get(dispatcher.counters, base + @depth),
+        high_water: :counters.get(dispatcher.counters, base + @high_water),
+        dispatched: :counters.get(dispatcher.counters, base + @dispatched),
+        dropped: :counters.get(dispatcher.counters, base + @dropped)
+      }
+    end
+  end
+
+  @doc """
+  Stop the workers. Changes still queued are discarded.
+  """
+  @spec stop(t()) :: :ok
+  def stop(%__MODULE__{} = dispatcher) do
+    dispatcher.workers
+    |> Tuple.to_list()
+    |> Enum.each(fn pid ->
+      Process.unlink(pid)
+      Process.exit(pid, :kill)
+    end)
+  end
+
+  defp partition(dispatcher, endpoint_id, cluster_id, attribute_id) do
+    key =
+      case dispatcher.key do
+        :endpoint -> endpoint_id
+        :cluster -> cluster_id
+        :path -> {endpoint_id, cluster_id, attribute_id}
+        fun when is_function(fun, 3) -> fun.(endpoint_id, cluster_id, attribute_id)
+      end
+
+    :erlang.phash2(key, tuple_size(dispatcher.workers))
+  end
+
+  # Workers
+
+  defp worker_init(owner, handler, counters, partition) do
+    Process.flag(:message_queue_data, :off_heap)
+    ref = Process.monitor(owner)
+    worker_loop(ref, handler, counters, partition * @slots + @depth)
+  end
+
+  defp worker_loop(ref, handler, counters, depth) do
+    receive do
+      {:attribute_change, change} ->
+        handle_change(handler, change)
+        :counters.sub(counters, depth, 1)
+        worker_loop(ref, handler, counters, depth)
+
+      {:DOWN, ^ref, :process, _pid, _reason} ->
+        :ok
+    end
+  end
+
+  defp handle_change(handler, {endpoint_id, cluster_id, attribute_id, type, value}) do
+    case handler.handle_attribute_change(endpoint_id, cluster_id, attribute_id, type, value) do
+      :ok -> :ok
+      {:error, reason} -> Logger.warning("Matter handler returned error: #{inspect(reason)}")
+    end
+  catch
+    kind, reason ->
+      Logger.error(
+        "Matter handler failed for #{inspect({endpoint_id, cluster_id, attribute_id})}: " <>
+          Exception.format(kind, reason, __STACKTRACE__)
+      )
+  end
+end
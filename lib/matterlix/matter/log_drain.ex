@@ -0,0 +1,109 @@
+defmodule Matterlix.Matter.LogDrain do
+  @moduledoc """
+  Forwards Matter SDK log output to `Logger`.
+
+  By default the SDK writes its ChipLog output to stdout. With the `:log`
+  option, `Matterlix.Matter` redirects it into a fixed-size ring buffer in
+  the NIF instead, and this process hands the records to `Logger` in
+  batches:
+
+      Matterlix.Matter.start_link(log: [level: :info, modules: [{"DMG", :debug}]])
+
+  Logging then costs the Matter thread one format and one copy per record,
+  and nothing is written to the filesystem.
+
+  ## Options
+  - `:capacity` - ring size in records (default: 1024)
+  - `:batch_size` - records per message to this process (default: 64)
+  - `:interval` - maximum time in milliseconds a record waits in the ring
+    (default: 100)
+  - `:level` - lowest level kept: `:none`, `:error`, `:info` (default) or `:debug`
+  - `:modules` - levels for individual ChipLog modules, a list of
+    `{module, level}` such as `[{"DMG", :debug}]`
+  - `:crash_file` - if the OS process dies of SIGSEGV, SIGABRT or SIGBUS,
+    append the records still in the ring to this file (for example on
+    `/data`, which survives the reboot)
+
+  Records are logged with the `:matter_module` metadata and, since they
+  reach `Logger` up to `:interval` late, the time they were written as
+  `:matter_time_us` (system time in microseconds). Records lost because the
+  ring was full are counted as `dropped` in `Matterlix.Matter.log_stats/1`.
+
+  The process exits with the server that started it.
+  """
+
+  require Logger
+
+  alias Matterlix.Matter.NIF
+
+  @doc """
+  Start the drain, linked to and monitoring the caller, and point the NIF
+  log ring at it.
+  """
+  @spec start_link(reference(), keyword()) :: {:ok, pid()} | {:error, term()}
+  def start_link(context, opts \\ []) do
+    owner = self()
+    pid = spawn_link(fn -> drain_init(owner) end)
+
+    level = Keyword.get(opts, :level, :info)
+    modules = Keyword.get(opts, :modules, [])
+    capacity = Keyword.get(opts, :capacity, 1024)
+    batch_size = Keyword.get(opts, :batch_size, 64)
+    interval = Keyword.get(opts, :interval, 100)
+
+    with :ok <- NIF.nif_set_log_levels(context, level, modules),
+         :ok <- NIF.nif_configure_log(context, pid, capacity, batch_size, interval),
+         :ok <- NIF.nif_set_log_crash_file(context, Keyword.get(opts, :crash_file)) do
+      {:ok, pid}
+    else
+      {:error, _reason} = error ->
+        NIF.nif_configure_log(context, nil, 0, 0, 0)
+        stop_drain(pid)
+        error
+    end
+  end
+
+  @doc """
+  Hand ChipLog output back to stdout and stop the drain once it has logged
+  what the ring still held.
+  """
+  @spec stop(reference(), pid()) :: :ok
+  def stop(context, pid) do
+    NIF.nif_set_log_crash_file(context, nil)
+    NIF.nif_configure_log(context, nil, 0, 0, 0)
+    stop_drain(pid)
+  end
+
+  defp stop_drain(pid) do
+    Process.unlink(pid)
+    send(pid, :stop)
+    :ok
+  end
+
+  defp drain_init(owner) do
+    Process.flag(:message_queue_data, :off_heap)
+    ref = Process.monitor(owner)
+    drain_loop(ref)
+  end
+
+  defp drain_loop(ref) do
+    receive do
+      {:matter_log, records} ->
+        Enum.each(records, &log_record/1)
+        drain_loop(ref)
+
+      :stop ->
+        :ok
+
+      {:DOWN, ^ref, :process, _pid, _reason} ->
+        :ok
+    end
+  end
+
+  defp log_record({time_us, level, module, message}) do
+    Logger.log(level, "Matter #{module}: #{message}",
+      matter_module: module,
+      matter_time_us: time_us
+    )
+  end
+end
@@ -4,24 +4,60 @@ defmodule Matterlix.Matter.NIF do
 
   This module provides direct access to the C++ NIF functions.
   For a higher-level API, use `Matterlix.Matter` instead.
+
+  ## Hot upgrades
+
+  Loading a new version of this module hands the running server, its
+  listener, event queue, log ring and every existing context over to it
+  without stopping anything. The new version loads the library image that
+  is already in memory, even if the application's `priv` directory has
+  moved, because the SDK lives in that image; a rebuilt library takes
+  effect at the next restart of the node. `nif_get_info/1` counts the
+  upgrades a server has survived.
   """
 
   @on_load :load_nif
 
   require Logger
 
+  @typedoc "An attribute write: `{endpoint_id, cluster_id, attribute_id, value}`"
+  @type attribute_write :: {non_neg_integer(), non_neg_integer(), non_neg_integer(), term()}
+
+  @typedoc "A change filter pattern: `{endpoint_id, cluster_id, attribute_id}`, `:_` matches any"
+  @type change_pattern ::
+          {non_neg_integer() | :_, non_neg_integer() | :_, non_neg_integer() | :_}
+
+  @typedoc "A device to bridge: `{kind, label, unique_id}`, see `nif_add_bridged_endpoint/3`"
+  @type bridged_device ::
+          {:on_off_light | :dimmable_light | :temperature_sensor | :humidity_sensor
+           | :contact_sensor, binary(), binary()}
+
+  @typedoc "A log ring filter level, see `nif_set_log_levels/3`"
+  @type log_level :: :none | :error | :info | :debug
+
   @doc false
   def load_nif do
-    nif_path = :filename.join(:code.priv_dir(:matterlix), ~c"matter_nif")
+    priv_path = :filename.join(:code.priv_dir(:matterlix), ~c"matter_nif")
+    nif_path = :persistent_term.get({__MODULE__, :library}, priv_path)
+
+    if nif_path != priv_path do
+      Logger.info("Matter NIF upgrade keeps #{nif_path}; restart to load #{priv_path}")
+    end
 
     case :erlang.load_nif(nif_path, 0) do
       :ok ->
+        :persistent_term.put({__MODULE__, :library}, nif_path)
         Logger.info("Matter NIF loaded successfully from #{nif_path}")
         :ok
 
       {:error, {:reload, _}} ->
         :ok
 
+      # Failing on_load keeps the running version of the module
+      {:error, {:upgrade, _}} = error ->
+        Logger.error("Matter NIF upgrade refused, keeping the running version: #{inspect(error)}")
+        error
+
       {:error, reason} ->
         Logger.error("Failed to load Matter NIF: #{inspect(reason)}")
         :ok
@@ -43,14 +79,35 @@ defmodule Matterlix.Matter.NIF do
   Start the Matter server.
 
   This makes the device discoverable and commissionable on the network.
+  Returns `{:error, :already_started}` if a server is already running, for
+  instance one taken over from an earlier context.
   """
   @spec nif_start_server(reference()) :: :ok | {:error, atom()}
   def nif_start_server(_context) do
     :erlang.nif_error(:nif_not_loaded)
   end
 
+  @doc """
+  Start the Matter server on a background thread and return immediately.
+
+  The calling process receives `{:matter_start_phase, phase, elapsed_us}` as
+  each phase completes, with the time spent in that phase, followed by
+  `{:matter_started, :ok | {:error, reason}}`. Phases, in order:
+  `:static_resources`, `:commissionable_data`, `:config`, `:server_init`
+  and `:event_loop`.
+
+  Returns `{:error, :already_starting}` if a start is already in progress.
+  """
+  @spec nif_start_server_async(reference()) :: :ok | {:error, atom()}
+  def nif_start_server_async(_context) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
   @doc """
   Stop the Matter server.
+
+  Returns `{:error, :starting}` while a start is still in progress; wait for
+  `{:matter_started, _}` and stop it then.
   """
   @spec nif_stop_server(reference()) :: :ok | {:error, atom()}
   def nif_stop_server(_context) do
@@ -62,13 +119,160 @@ defmodule Matterlix.Matter.NIF do
 
   Returns a map containing device information such as:
   - `:initialized` - whether the SDK has been initialized
+  - `:sdk_enabled` - whether the NIF was built against the Matter SDK (false in stub mode)
   - `:nif_version` - version of the NIF
+  - `:is_owner` - whether this context owns the SDK and receives its callbacks
+  - `:server_started` - whether a server is running, including one started
+    through an earlier context or module version
+  - `:upgrades` - hot upgrades of this module since the library was loaded
   """
   @spec nif_get_info(reference()) :: {:ok, map()} | {:error, atom()}
   def nif_get_info(_context) do
     :erlang.nif_error(:nif_not_loaded)
   end
 
+  @doc """
+  Get the completion time of each lifecycle phase that has happened so far.
+
+  Returns a map of phase to `CLOCK_MONOTONIC` microseconds (time since boot
+  on Linux). Phases: `:load`, `:chip_stack`, `:wifi_commissioning`, `:init`,
+  the start phases of `nif_start_server_async/1`, and `:first_advertisement`
+  (DNS-SD ready, when the commissionable node is first advertised). Start
+  phases reflect the most recent start.
+  """
+  @spec nif_get_timings(reference()) :: {:ok, %{atom() => integer()}} | {:error, atom()}
+  def nif_get_timings(_context) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Get runtime statistics, cumulative since the NIF library was loaded.
+
+  Returns a map with:
+  - `:calls` - map of NIF name to call count
+  - `:global_mutex_wait` - time spent waiting for the NIF's global mutex
+  - `:chip_lock_wait` / `:chip_lock_hold` - time spent waiting for and
+    holding the Matter stack lock (the stub store lock in stub mode)
+  - `:attribute_changes` - `%{seen, filtered, sent, queued, fanned_out}` change
+    callbacks; `fanned_out` counts extra copies sent to subscribers
+  - `:env_alloc_failures` - message environments that could not be allocated
+  - `:event_queue` - `%{overflow, dropped}` summed over every event queue
+
+  Latency histograms are `%{count, sum_us, buckets}` where `buckets` is a list
+  of `{upper_us, n}` counting samples below `upper_us` (powers of two from 1us),
+  ending with `{:infinity, n}`.
+  """
+  @spec nif_get_stats(reference()) :: {:ok, map()} | {:error, atom()}
+  def nif_get_stats(_context) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Get memory usage for capacity planning.
+
+  Returns a map with:
+  - `:process` - `%{rss_bytes, rss_high_water_bytes}` of the whole OS process
+    (the BEAM included), from `/proc/self/status`; zero where that is missing
+  - `:nif` - `%{event_queue_bytes, bridge_arena_bytes, attribute_store_bytes,
+    log_ring_bytes}`, buffers the NIF itself allocated (the attribute store
+    only in stub mode)
+
+  With the Matter SDK, also:
+  - `:heap` - `%{used_bytes, free_bytes, high_water_bytes}` from the platform
+    diagnostics; keys the platform cannot report are left out
+  - `:pools` - the pool sizes compiled into the SDK: `:exchange_contexts`,
+    `:secure_sessions`, `:reads`, `:subscriptions`, `:fabrics`,
+    `:packet_buffers` (0 when packet buffers come from the heap) and
+    `:dynamic_endpoints`. They are set per device profile, see
+    `Matterlix.DeviceProfiles`
+  - `:in_use` - `%{exchanges, reads, subscriptions, fabrics}` currently
+    active; empty until the server has started
+  - `:resources` - `%{label => {in_use, high_water}}` for every CHIP system
+    resource counter (packet buffers, timers, endpoints, exchanges); empty
+    unless the SDK was built with `statistics: true`
+  """
+  @spec nif_get_memory_stats(reference()) :: {:ok, map()} | {:error, atom()}
+  def nif_get_memory_stats(_context) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Enable, reconfigure or disable the in-memory log ring.
+
+  While enabled, ChipLog output and the NIF's own messages (module `"NIF"`)
+  are kept in a fixed-size ring instead of being written to stdout. A drain
+  thread delivers them to `recipient` as
+  `{:matter_log, [{time_us, level, module, message}]}` messages, where
+  `time_us` is system time in microseconds and `level` is `:error`, `:info`
+  or `:debug`. With `recipient` nil the records are only kept for the crash
+  file, see `nif_set_log_crash_file/2`.
+
+  ## Parameters
+  - `context` - The Matter context
+  - `recipient` - Process receiving the records, or `nil`
+  - `capacity` - Ring size in records (rounded up to a power of two), `0` disables the ring
+  - `batch_size` - Maximum records per message; a full batch is delivered immediately
+  - `interval_ms` - Maximum time a record waits in the ring
+
+  A full ring overwrites its oldest records, counted as `dropped` in
+  `nif_get_log_stats/1`.
+  """
+  @spec nif_configure_log(
+          reference(),
+          pid() | nil,
+          non_neg_integer(),
+          non_neg_integer(),
+          non_neg_integer()
+        ) :: :ok | {:error, atom()}
+  def nif_configure_log(_context, _recipient, _capacity, _batch_size, _interval_ms) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Set which records the log ring keeps.
+
+  Records are filtered before they are formatted. `level` applies to every
+  module not listed in `modules`, a list of `{module, level}` with ChipLog
+  module names such as `"DMG"` or `"DIS"`. Levels are `:none`, `:error`,
+  `:info` (the default) and `:debug`.
+
+  ## Example
+
+      # Errors only, except the data model and discovery
+      :ok = nif_set_log_levels(ctx, :error, [{"DMG", :debug}, {"DIS", :info}])
+  """
+  @spec nif_set_log_levels(reference(), log_level(), [{String.t(), log_level()}]) ::
+          :ok | {:error, atom()}
+  def nif_set_log_levels(_context, _level, _modules) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Write the records still in the log ring to `path` if the OS process dies
+  of SIGSEGV, SIGABRT or SIGBUS.
+
+  The file is only opened from the signal handler, which appends the ring
+  and the signal name and then passes the signal on. `nil` removes the
+  handler.
+  """
+  @spec nif_set_log_crash_file(reference(), Path.t() | nil) :: :ok | {:error, atom()}
+  def nif_set_log_crash_file(_context, _path) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Get counters for the log ring.
+
+  Returns a map with `:enabled`, `:capacity`, `:depth` and the cumulative
+  `:written`, `:filtered`, `:dropped`, `:delivered`, `:undelivered` and
+  `:batches` counters.
+  Counters restart whenever the ring is reconfigured.
+  """
+  @spec nif_get_log_stats(reference()) :: {:ok, map()} | {:error, atom()}
+  def nif_get_log_stats(_context) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
   @doc """
   Set a Matter attribute value.
 
@@ -77,7 +281,25 @@ defmodule Matterlix.Matter.NIF do
   - `endpoint_id` - The endpoint ID (usually 1 for simple devices)
   - `cluster_id` - The cluster ID (e.g., 0x0006 for On/Off)
   - `attribute_id` - The attribute ID within the cluster
-  - `value` - The value to set
+  - `value` - The value to set, see "Value types" below
+
+  ## Value types
+
+  Values are encoded according to the attribute's ZCL type:
+
+  | ZCL type                                 | Elixir value           |
+  |------------------------------------------|------------------------|
+  | boolean                                  | `true` / `false`       |
+  | int8u..int64u, enum8/16, bitmap8..64     | non-negative integer   |
+  | int8s..int64s                            | integer                |
+  | single, double                           | float (or integer)     |
+  | char_string, long_char_string            | UTF-8 binary           |
+  | octet_string, long_octet_string          | binary                 |
+
+  `nil` writes null to a nullable attribute. Out-of-range values, the wrong
+  kind of value and `nil` for a non-nullable attribute return
+  `{:error, :invalid_value}`; list and struct attributes return
+  `{:error, :unsupported_type}`.
   """
   @spec nif_set_attribute(
           reference(),
@@ -91,6 +313,26 @@ defmodule Matterlix.Matter.NIF do
     :erlang.nif_error(:nif_not_loaded)
   end
 
+  @doc """
+  Set several Matter attribute values in one call.
+
+  All writes are applied while holding the CHIP stack lock once, which is much
+  cheaper than issuing one `nif_set_attribute/5` per value. Each entry is
+  validated and written independently.
+
+  ## Parameters
+  - `context` - The Matter context
+  - `attributes` - A list of `{endpoint_id, cluster_id, attribute_id, value}` tuples
+
+  Returns `{:ok, results}` where `results` holds `:ok` or `{:error, reason}`
+  for each entry, in the same order as `attributes`.
+  """
+  @spec nif_set_attributes(reference(), [attribute_write()]) ::
+          {:ok, [:ok | {:error, atom()}]} | {:error, atom()}
+  def nif_set_attributes(_context, _attributes) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
   @doc """
   Get a Matter attribute value.
 
@@ -99,6 +341,10 @@ defmodule Matterlix.Matter.NIF do
   - `endpoint_id` - The endpoint ID
   - `cluster_id` - The cluster ID
   - `attribute_id` - The attribute ID
+
+  Values decode to the types listed in `nif_set_attribute/5`; strings are
+  returned as binaries. Null values of nullable attributes and attributes of
+  unsupported types (lists, structs) read as `nil`.
   """
   @spec nif_get_attribute(reference(), non_neg_integer(), non_neg_integer(), non_neg_integer()) ::
           {:ok, term()} | {:error, atom()}
@@ -106,6 +352,204 @@ defmodule Matterlix.Matter.NIF do
     :erlang.nif_error(:nif_not_loaded)
   end
 
+  @doc """
+  Queue an attribute write on the Matter event loop and return immediately.
+
+  Unlike `nif_set_attribute/5`, the calling scheduler never waits for the
+  CHIP stack lock. The result is sent to the calling process as
+  `{:matter_reply, ref, result}`, where `result` is what
+  `nif_set_attribute/5` would have returned.
+
+  Returns `{:error, :not_started}` without queueing anything if the server
+  is not running. Operations still queued when the SDK shuts down are never
+  answered, so callers should wait with a timeout.
+  """
+  @spec nif_set_attribute_async(
+          reference(),
+          non_neg_integer(),
+          non_neg_integer(),
+          non_neg_integer(),
+          term()
+        ) ::
+          {:ok, reference()} | {:error, atom()}
+  def nif_set_attribute_async(_context, _endpoint_id, _cluster_id, _attribute_id, _value) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Queue an attribute read on the Matter event loop and return immediately.
+
+  The value arrives as `{:matter_reply, ref, {:ok, value} | {:error, reason}}`.
+  See `nif_set_attribute_async/5`.
+  """
+  @spec nif_get_attribute_async(
+          reference(),
+          non_neg_integer(),
+          non_neg_integer(),
+          non_neg_integer()
+        ) ::
+          {:ok, reference()} | {:error, atom()}
+  def nif_get_attribute_async(_context, _endpoint_id, _cluster_id, _attribute_id) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Resolve an attribute path once and return a handle for the `*_h` functions.
+
+  The handle caches the attribute's metadata, so `nif_set_attribute_h/3` and
+  `nif_get_attribute_h/2` skip argument decoding and the metadata search that
+  `nif_set_attribute/5` and `nif_get_attribute/4` do on every call.
+
+  Handles become stale when the endpoint layout changes (for example when the
+  server is restarted); the `*_h` functions then return
+  `{:error, :stale_handle}` and the attribute must be resolved again.
+  """
+  @spec nif_resolve_attribute(
+          reference(),
+          non_neg_integer(),
+          non_neg_integer(),
+          non_neg_integer()
+        ) ::
+          {:ok, reference()} | {:error, atom()}
+  def nif_resolve_attribute(_context, _endpoint_id, _cluster_id, _attribute_id) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Set a Matter attribute value through a handle from `nif_resolve_attribute/4`.
+  """
+  @spec nif_set_attribute_h(reference(), reference(), term()) :: :ok | {:error, atom()}
+  def nif_set_attribute_h(_context, _handle, _value) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Get a Matter attribute value through a handle from `nif_resolve_attribute/4`.
+  """
+  @spec nif_get_attribute_h(reference(), reference()) :: {:ok, term()} | {:error, atom()}
+  def nif_get_attribute_h(_context, _handle) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Read every attribute of a server cluster on an endpoint.
+
+  All attributes are read under a single CHIP stack lock, so the values are
+  consistent with each other. Attributes that cannot be read from attribute
+  storage are omitted, and attributes of unsupported types map to `nil`.
+
+  ## Parameters
+  - `context` - The Matter context
+  - `endpoint_id` - The endpoint ID
+  - `cluster_id` - The cluster ID
+
+  Returns `{:ok, %{attribute_id => value}}`, or `{:error, :cluster_not_found}`
+  if the endpoint does not implement the cluster.
+  """
+  @spec nif_read_cluster(reference(), non_neg_integer(), non_neg_integer()) ::
+          {:ok, %{non_neg_integer() => term()}} | {:error, atom()}
+  def nif_read_cluster(_context, _endpoint_id, _cluster_id) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Preallocate the arena for bridged endpoints.
+
+  A bridge exposes the devices behind it as dynamic endpoints (see
+  `nif_add_bridged_endpoint/3`). Their attribute values live in one arena
+  sized here, so adding and removing devices afterwards allocates nothing.
+  Fails with `{:error, :bridge_busy}` while endpoints are bridged.
+
+  ## Parameters
+  - `context` - The Matter context
+  - `capacity` - Bridged endpoints that can exist at once, `0` frees the arena.
+    With the SDK at most `CHIP_DEVICE_CONFIG_DYNAMIC_ENDPOINT_COUNT`.
+  - `first_endpoint_id` - The lowest endpoint ID handed out, after the
+    endpoints of the device profile
+
+  With the SDK this needs a profile with dynamic endpoints, such as `:bridge`.
+  """
+  @spec nif_configure_bridge(reference(), non_neg_integer(), non_neg_integer()) ::
+          :ok | {:error, atom()}
+  def nif_configure_bridge(_context, _capacity, _first_endpoint_id) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Bridge a device as a dynamic endpoint under `parent_endpoint_id` (usually
+  the aggregator, endpoint 1).
+
+  Every bridged endpoint has the Descriptor and Bridged Device Basic
+  Information clusters, plus the clusters of its kind:
+
+  - `:on_off_light` - On/Off
+  - `:dimmable_light` - On/Off, Level Control
+  - `:temperature_sensor` - Temperature Measurement
+  - `:humidity_sensor` - Relative Humidity Measurement
+  - `:contact_sensor` - Boolean State
+
+  `label` (NodeLabel) and `unique_id` (UniqueID) are binaries of at most 32
+  bytes. Read and write the attributes with the usual attribute functions.
+
+  Returns `{:ok, endpoint_id}`, or `{:error, :bridge_full}` when the arena
+  from `nif_configure_bridge/3` is used up.
+  """
+  @spec nif_add_bridged_endpoint(reference(), non_neg_integer(), bridged_device()) ::
+          {:ok, non_neg_integer()} | {:error, atom()}
+  def nif_add_bridged_endpoint(_context, _parent_endpoint_id, _device) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Bridge several devices under one CHIP stack lock, see
+  `nif_add_bridged_endpoint/3`.
+
+  Returns `{:ok, results}` with one `{:ok, endpoint_id}` or `{:error, reason}`
+  per device, in order.
+  """
+  @spec nif_add_bridged_endpoints(reference(), non_neg_integer(), [bridged_device()]) ::
+          {:ok, [{:ok, non_neg_integer()} | {:error, atom()}]} | {:error, atom()}
+  def nif_add_bridged_endpoints(_context, _parent_endpoint_id, _devices) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Remove a bridged endpoint. Handles resolved against it become stale.
+  """
+  @spec nif_remove_bridged_endpoint(reference(), non_neg_integer()) :: :ok | {:error, atom()}
+  def nif_remove_bridged_endpoint(_context, _endpoint_id) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Remove several bridged endpoints under one CHIP stack lock.
+
+  Returns `{:ok, results}` with one `:ok` or `{:error, reason}` per endpoint.
+  """
+  @spec nif_remove_bridged_endpoints(reference(), [non_neg_integer()]) ::
+          {:ok, [:ok | {:error, atom()}]} | {:error, atom()}
+  def nif_remove_bridged_endpoints(_context, _endpoint_ids) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Get the size and counters of the bridged endpoint arena.
+
+  - `:capacity` - endpoints the arena holds
+  - `:endpoints` - endpoints bridged right now
+  - `:slot_bytes` - attribute value bytes per endpoint
+  - `:bytes_per_endpoint` - all arena bytes per endpoint, including data
+    versions and bookkeeping
+  - `:arena_bytes` - `capacity * bytes_per_endpoint`
+  - `:added`, `:removed` - endpoints added and removed since load
+  - `:last_add_us`, `:last_add_count` - duration (under the stack lock) and
+    size of the last add
+  """
+  @spec nif_get_bridge_stats(reference()) :: {:ok, %{atom() => integer()}} | {:error, atom()}
+  def nif_get_bridge_stats(_context) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
   @doc """
   Open the commissioning window to allow pairing.
   """
@@ -124,12 +568,239 @@ defmodule Matterlix.Matter.NIF do
 
   @doc """
   Register the calling process to receive Matter events.
+
+  Also makes `context` the owner of the SDK if the owner is gone, detached
+  or its listener has exited, taking over a running server.
   """
   @spec nif_register_callback(reference()) :: :ok | {:error, atom()}
   def nif_register_callback(_context) do
     :erlang.nif_error(:nif_not_loaded)
   end
 
+  @doc """
+  Give up ownership of the SDK without stopping the server.
+
+  Events no longer reach this context's listener, and the server keeps
+  running after the context is released. The next context to be created
+  or to call `nif_register_callback/1` takes it over.
+  """
+  @spec nif_detach(reference()) :: :ok | {:error, atom()}
+  def nif_detach(_context) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Enable, reconfigure or disable queued delivery of attribute changes.
+
+  While enabled, the Matter thread only copies each change into a bounded
+  ring buffer. A drain thread delivers them to the registered process as
+  `{:attribute_changes, [{endpoint_id, cluster_id, attribute_id, type, value}]}`
+  messages instead of one `{:attribute_changed, ...}` message per change.
+
+  ## Parameters
+  - `context` - The Matter context
+  - `capacity` - Ring size in changes (rounded up to a power of two), `0` disables the queue
+  - `batch_size` - Maximum changes per message; a full batch is delivered immediately
+  - `interval_ms` - Maximum time a change waits in the queue
+
+  Changes arriving while the ring is full are counted as `overflow` in
+  `nif_get_event_queue_stats/1`. Values longer than 16 bytes (strings) are
+  copied out of line into a buffer of 16 bytes per ring slot; one arriving
+  while that buffer is full is delivered as `nil`, like unsupported types.
+  """
+  @spec nif_configure_event_queue(
+          reference(),
+          non_neg_integer(),
+          non_neg_integer(),
+          non_neg_integer()
+        ) ::
+          :ok | {:error, atom()}
+  def nif_configure_event_queue(_context, _capacity, _batch_size, _interval_ms) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Get counters for the attribute change event queue.
+
+  Returns a map with `:enabled`, `:capacity`, `:depth` and the cumulative
+  `:pushed`, `:delivered`, `:overflow`, `:dropped`, `:batches` and
+  `:coalesced` counters.
+  Counters restart whenever the queue is reconfigured.
+  """
+  @spec nif_get_event_queue_stats(reference()) :: {:ok, map()} | {:error, atom()}
+  def nif_get_event_queue_stats(_context) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Install a filter for attribute change notifications.
+
+  The filter is checked on the Matter thread before a change is queued or
+  sent, so filtered changes never reach the BEAM. It applies to the listener
+  registered with `nif_register_callback/1`; subscribers have their own, see
+  `nif_subscribe/3`.
+
+  ## Parameters
+  - `context` - The Matter context
+  - `filter` - One of:
+    - `{:allow, patterns}` - deliver only changes matching a pattern
+    - `{:deny, patterns}` - deliver everything except changes matching a pattern
+    - `nil` - remove the filter and deliver every change
+
+  Each pattern is `{endpoint_id, cluster_id, attribute_id}` where any
+  component may be `:_` to match everything.
+
+  ## Example
+
+      # Ignore Identify and Basic Information on every endpoint
+      :ok = nif_set_change_filter(ctx, {:deny, [{:_, 0x0003, :_}, {:_, 0x0028, :_}]})
+  """
+  @spec nif_set_change_filter(reference(), {:allow | :deny, [change_pattern()]} | nil) ::
+          :ok | {:error, atom()}
+  def nif_set_change_filter(_context, _filter) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Deliver attribute changes to `pid` as well as to the listener.
+
+  Subscribers get the same `{:attribute_changed, ...}` messages, or
+  `{:attribute_changes, [...]}` batches with the event queue enabled, as the
+  listener. Each change is turned into a term once and copied to every
+  recipient. WiFi and commissioning requests still go to the listener only.
+
+  `filter` chooses the changes for this subscriber and takes the same form
+  as in `nif_set_change_filter/2` (`nil` for every change); subscribing
+  again replaces it. The subscription is monitored and ends when `pid`
+  exits. Up to 32 processes can subscribe.
+
+  ## Example
+
+      :ok = nif_subscribe(ctx, self(), {:allow, [{:_, 0x0006, :_}]})
+  """
+  @spec nif_subscribe(reference(), pid(), {:allow | :deny, [change_pattern()]} | nil) ::
+          :ok | {:error, atom()}
+  def nif_subscribe(_context, _pid, _filter) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Stop delivering attribute changes to `pid`.
+
+  Returns `{:error, :not_subscribed}` if it has no subscription.
+  """
+  @spec nif_unsubscribe(reference(), pid()) :: :ok | {:error, atom()}
+  def nif_unsubscribe(_context, _pid) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  List the subscribed processes, in the order they subscribed.
+  """
+  @spec nif_get_subscribers(reference()) :: {:ok, [pid()]} | {:error, atom()}
+  def nif_get_subscribers(_context) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Install per-path coalescing rules for queued attribute changes.
+
+  Changes on a path matching a rule are delivered at most once per
+  `min_interval_ms`. Changes inside the window replace each other (latest
+  value wins) and the last one is delivered when the window closes, so the
+  final value of a transition is never lost. The first matching rule applies.
+
+  Coalescing is done by the event queue's drain thread and only takes effect
+  while the queue is enabled (see `nif_configure_event_queue/4`). Replaced
+  values are counted as `coalesced` in `nif_get_event_queue_stats/1`.
+
+  ## Parameters
+  - `context` - The Matter context
+  - `rules` - A list of `{pattern, min_interval_ms}`, where `pattern` is
+    `{endpoint_id, cluster_id, attribute_id}` with `:_` wildcards; `[]` removes all rules
+
+  ## Example
+
+      # At most one Level Control and Color Control update per 100ms
+      :ok = nif_set_coalescing(ctx, [{{:_, 0x0008, :_}, 100}, {{:_, 0x0300, :_}, 100}])
+  """
+  @spec nif_set_coalescing(reference(), [{change_pattern(), pos_integer()}]) ::
+          :ok | {:error, atom()}
+  def nif_set_coalescing(_context, _rules) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Open a write transaction.
+
+  Until the matching `nif_commit_writes/1`, attribute writes (from any
+  process) update attribute storage and report local changes as usual, but
+  are marked dirty for subscription reports only at commit, all at once.
+  Subscribed controllers then get one consolidated report for the burst
+  instead of one per write. Transactions nest; marking happens when the last
+  one commits.
+
+  Every `nif_begin_writes/1` must be followed by `nif_commit_writes/1`,
+  or reports stay deferred. `Matterlix.Matter.write_transaction/2` pairs them
+  and commits if the caller exits.
+  """
+  @spec nif_begin_writes(reference()) :: :ok | {:error, atom()}
+  def nif_begin_writes(_context) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Close a write transaction, see `nif_begin_writes/1`.
+
+  Returns `{:ok, marked}` with the number of attribute paths marked dirty by
+  this commit (0 while other transactions are still open), or
+  `{:error, :no_transaction}`.
+  """
+  @spec nif_commit_writes(reference()) :: {:ok, non_neg_integer()} | {:error, atom()}
+  def nif_commit_writes(_context) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Set per-cluster minimum reporting intervals.
+
+  A write to a cluster that was marked dirty less than `min_interval_ms` ago
+  is held, and marked together with the cluster's other held writes once the
+  interval has passed. Unlike the subscription's own minimum interval this
+  applies to every controller, and unlike `nif_set_coalescing/2` it acts on
+  reports to controllers rather than on notifications to Elixir. `[]`
+  removes all intervals and marks held writes.
+
+  ## Parameters
+  - `context` - The Matter context
+  - `intervals` - `[{cluster_id, min_interval_ms}]`
+
+  ## Example
+
+      # At most one Electrical Power Measurement report every 500ms
+      :ok = nif_set_report_intervals(ctx, [{0x0090, 500}])
+  """
+  @spec nif_set_report_intervals(reference(), [{non_neg_integer(), pos_integer()}]) ::
+          :ok | {:error, atom()}
+  def nif_set_report_intervals(_context, _intervals) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Get write transaction and report deferral counters.
+
+  - `:transactions` - write transactions open now
+  - `:pending` - written attribute paths not yet marked dirty
+  - `:deferred` - writes whose marking was deferred, since load
+  - `:flushed` - deferred paths marked dirty, after deduplication
+  - `:flushes` - commits and interval expiries that marked paths
+  """
+  @spec nif_get_report_stats(reference()) ::
+          {:ok, %{atom() => non_neg_integer()}} | {:error, atom()}
+  def nif_get_report_stats(_context) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
   @doc """
   Schedule a factory reset of the device.
   """
@@ -164,15 +835,46 @@ defmodule Matterlix.Matter.NIF do
   ## Parameters
   - `context` - The Matter context
   - `status` - 0 for success, non-zero for failure
+  - `results` - the networks found, packed one record after another (see
+    `Matterlix.Matter.WiFiScan.encode/2`):
+
+        <<security::8, band::8, channel::16-big, rssi::signed-8,
+          bssid::binary-size(6), ssid_size::8, ssid::binary-size(ssid_size)>>
+
+    At most 64 records and 32-byte SSIDs; anything else is rejected with
+    `{:error, :invalid_args}`. Defaults to no networks.
+  """
+  @spec nif_wifi_scan_result(reference(), integer(), binary()) :: :ok | {:error, atom()}
+  def nif_wifi_scan_result(_context, _status, _results \\ <<>>) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Queue the result of a WiFi connection attempt on the Matter event loop.
+  Replies with `{:matter_reply, ref, :ok}`; see `nif_set_attribute_async/5`.
+  """
+  @spec nif_wifi_connect_result_async(reference(), integer()) ::
+          {:ok, reference()} | {:error, atom()}
+  def nif_wifi_connect_result_async(_context, _status) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Queue the result of a WiFi scan on the Matter event loop. `results` is
+  checked before queuing, as in `nif_wifi_scan_result/3`.
+  Replies with `{:matter_reply, ref, :ok}`; see `nif_set_attribute_async/5`.
   """
-  @spec nif_wifi_scan_result(reference(), integer()) :: :ok | {:error, atom()}
-  def nif_wifi_scan_result(_context, _status) do
+  @spec nif_wifi_scan_result_async(reference(), integer(), binary()) ::
+          {:ok, reference()} | {:error, atom()}
+  def nif_wifi_scan_result_async(_context, _status, _results \\ <<>>) do
     :erlang.nif_error(:nif_not_loaded)
   end
 
   @doc """
   Set the commissioning info (setup PIN and discriminator).
-  Must be called before starting the server for values to take effect.
+  Must be called before starting the server for values to take effect;
+  once the server runs, the discriminator is applied live and a new PIN is
+  recorded for the next start.
 
   ## Parameters
   - `context` - The Matter context
@@ -188,4 +890,126 @@ defmodule Matterlix.Matter.NIF do
   def nif_set_commissioning_info(_context, _setup_pin, _discriminator) do
     :erlang.nif_error(:nif_not_loaded)
   end
+
+  @doc """
+  Configure the SPAKE2+ verifier cache used at the next server start.
+
+  With a `path`, the verifier for the configured PIN is derived once and
+  stored there with its salt (written atomically). Later starts load it
+  instead of running PBKDF2 again, and rederive it only when the PIN or
+  `pbkdf_iterations` change. `nil` derives a fresh verifier on every start.
+
+  ## Parameters
+  - `context` - The Matter context
+  - `path` - Cache file path, or `nil` to disable the cache
+  - `pbkdf_iterations` - PBKDF2 iteration count (1000-100000)
+  """
+  @spec nif_set_verifier_cache(reference(), binary() | nil, pos_integer()) ::
+          :ok | {:error, atom()}
+  def nif_set_verifier_cache(_context, _path, _pbkdf_iterations) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Configure the coalescing key-value store used at the next server start.
+
+  The Matter server persists its fabric table, ACLs, session resumption
+  data and counters through this store. It keeps every key in memory and
+  writes the table to `path` as one file (one write, fsync and rename) at
+  most once per `flush_interval_ms`, instead of a flash write per change.
+  Writes to keys starting with one of `critical_prefixes` are on flash
+  before they return. Keys the store does not have yet are read from the
+  SDK's default KVS once, so a commissioned device keeps its fabrics when
+  it switches over. A file that fails its checksum makes the next start
+  return `{:error, :storage_load_failed}`.
+
+  ## Parameters
+  - `context` - The Matter context
+  - `path` - Store file path, or `nil` for the SDK's default KVS
+  - `flush_interval_ms` - Maximum time a change waits in memory (100-3600000)
+  - `critical_prefixes` - Key prefixes flushed immediately, or `nil` for the
+    defaults: fabric data (`"f/"`), the fabric index (`"g/fidx"`), fail-safe
+    markers (`"g/fs/"`) and the group message counters (`"g/gdc"`, `"g/gcc"`)
+  """
+  @spec nif_configure_storage(reference(), binary() | nil, pos_integer(), [binary()] | nil) ::
+          :ok | {:error, atom()}
+  def nif_configure_storage(_context, _path, _flush_interval_ms, _critical_prefixes) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Get counters for the coalescing key-value store.
+
+  Returns a map with `:enabled` (the next start uses a store), `:open` (a
+  store is in use), `:path`, `:keys`, `:bytes`, `:dirty` (changes not on
+  flash yet) and the cumulative `:writes`, `:unchanged` (writes of the value
+  already stored), `:flushes`, `:critical_flushes`, `:flush_errors` and
+  `:bytes_written` counters, plus the duration of the last flush as
+  `:last_flush_us`.
+  """
+  @spec nif_get_storage_stats(reference()) :: {:ok, map()} | {:error, atom()}
+  def nif_get_storage_stats(_context) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Set where OTA software update downloads go, from the next download on.
+
+  `receiver` gets `{:matter_ota, event, info}` for `:download_started`,
+  `:progress` (per percent), `:downloaded`, `:aborted`, `:error` and `:apply`,
+  where `info` holds the payload `:offset` and `:total` bytes (`nil` until
+  the image header is read) and, for `:error`, the `:reason`.
+
+  Without a `path`, `receiver` also gets the image payload one BDX block at a
+  time as `{:matter_ota_block, offset, data}`, and the next block is only
+  requested once it calls `nif_ota_ack/2`. With a `path`, the NIF writes the
+  payload to that file or FIFO itself (a FIFO needs its reader, such as
+  fwup, to be waiting when the download starts) and a full FIFO holds the
+  transfer until it drains. Either way at most one block is held at a time.
+
+  Payload before `resume_offset` is dropped rather than handed on, and a
+  regular file is truncated to that length and appended to; the download
+  itself still starts over from the beginning.
+
+  The OTA Requestor is set up at the first server start with a receiver.
+
+  ## Parameters
+  - `context` - The Matter context
+  - `receiver` - Process receiving the events, or `nil` to refuse downloads
+  - `path` - File the payload is written to, or `nil` to deliver the blocks
+  - `resume_offset` - Payload bytes the sink already has
+
+  Returns `{:error, :busy}` while a download is in progress.
+  """
+  @spec nif_configure_ota(reference(), pid() | nil, binary() | nil, non_neg_integer()) ::
+          :ok | {:error, atom()}
+  def nif_configure_ota(_context, _receiver, _path, _resume_offset) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Confirm that the receiver has consumed the OTA block ending at `offset`
+  (the block's offset plus its size), so the next block is requested.
+
+  Returns `{:error, :no_block}` if no block ending there is waiting.
+  """
+  @spec nif_ota_ack(reference(), non_neg_integer()) :: :ok | {:error, atom()}
+  def nif_ota_ack(_context, _offset) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
+
+  @doc """
+  Get the state and counters of OTA image streaming.
+
+  Returns a map with `:enabled`, `:sink` (`:process` or `:file`), `:state`
+  (`:idle`, `:downloading`, `:downloaded` or `:applying`), the payload
+  `:offset` and `:total` of the current download, `:resume_offset`, its
+  `:blocks`, the `:bytes` handed to the sink and `:skipped` before the resume
+  offset, and the cumulative `:write_stalls` (writes held by a full FIFO),
+  `:downloads` and `:aborts`.
+  """
+  @spec nif_get_ota_stats(reference()) :: {:ok, map()} | {:error, atom()}
+  def nif_get_ota_stats(_context) do
+    :erlang.nif_error(:nif_not_loaded)
+  end
 end
@@ -0,0 +1,214 @@
+defmodule Matterlix.Matter.OTA do
+  @moduledoc """
+  Streams Matter OTA software updates into fwup.
+
+  With the `:ota` option, `Matterlix.Matter` enables the SDK's OTA Software
+  Update Requestor and starts this process. It keeps fwup running, reading
+  a FIFO, and the NIF writes each BDX block of a download into that FIFO as
+  it arrives:
+
+      Matterlix.Matter.start_link(ota: [fwup_args: ["--apply", "--no-unmount",
+        "-d", "/dev/mmcblk0", "--task", "upgrade"]])
+
+  The image never passes through the BEAM and is never stored whole: the
+  NIF holds at most one block, and a full FIFO stalls the transfer until
+  fwup catches up, so memory use does not depend on the image size.
+
+  ## Options
+  - `:fwup` - the fwup executable (default: `fwup` on the `PATH`)
+  - `:fwup_args` - fwup arguments besides the input (default: apply the
+    `upgrade` task to `/dev/mmcblk0`)
+  - `:fifo` - the FIFO between the NIF and fwup, created if missing
+    (default: `/tmp/matter_ota.fifo`)
+  - `:path` - instead of fwup, have the NIF write the image payload to this
+    file, for example to apply it later
+  - `:resume_offset` - with `:path`, the length of an interrupted download
+    already in the file; it is kept and only the rest is written (default: 0)
+  - `:handler` - a `Matterlix.Handler` whose optional `handle_ota_event/2`
+    receives each event (`Matterlix.Matter` passes its own)
+
+  Events are `:download_started`, `:progress`, `:downloaded`, `:aborted`,
+  `:error` and `:apply`, each with a map of the payload `:offset` and
+  `:total` bytes (`nil` until known) and, for `:error`, the `:reason`.
+  `:apply` means the OTA provider allowed the new image to run: fwup has
+  already written it, so the handler should reboot into it. A fwup that
+  exits, after an update or a failed download, is started again a second
+  later.
+
+  The process exits with the server that started it.
+  """
+
+  require Logger
+
+  alias Matterlix.Matter.NIF
+
+  @default_fifo "/tmp/matter_ota.fifo"
+  @default_fwup_args ["--apply", "--no-unmount", "-d", "/dev/mmcblk0", "--task", "upgrade"]
+
+  # Delay before starting fwup again after it exits
+  @restart_delay 1_000
+
+  @doc """
+  Start streaming, linked to and monitoring the caller, and point the NIF's
+  OTA downloads at it.
+  """
+  @spec start_link(reference(), keyword()) :: {:ok, pid()} | {:error, term()}
+  def start_link(context, opts \\ []) do
+    with {:ok, sink} <- sink(opts) do
+      owner = self()
+      handler = Keyword.get(opts, :handler)
+      pid = spawn_link(fn -> stream_init(owner, handler, sink) end)
+      {path, resume_offset} = nif_sink(sink, opts)
+
+      case NIF.nif_configure_ota(context, pid, path, resume_offset) do
+        :ok ->
+          {:ok, pid}
+
+        {:error, _reason} = error ->
+          stop_stream(pid)
+          error
+      end
+    end
+  end
+
+  @doc """
+  Refuse further downloads and stop the process and its fwup.
+  """
+  @spec stop(reference(), pid()) :: :ok
+  def stop(context, pid) do
+    NIF.nif_configure_ota(context, nil, nil, 0)
+    stop_stream(pid)
+  end
+
+  defp sink(opts) do
+    case Keyword.fetch(opts, :path) do
+      {:ok, path} ->
+        {:ok, {:file, path}}
+
+      :error ->
+        fifo = Keyword.get(opts, :fifo, @default_fifo)
+        args = Keyword.get(opts, :fwup_args, @default_fwup_args)
+
+        with {:ok, exe} <- find_fwup(Keyword.get(opts, :fwup)),
+             :ok <- ensure_fifo(fifo) do
+          {:ok, {:fwup, exe, args ++ ["-i", fifo]}}
+        end
+    end
+  end
+
+  defp nif_sink({:file, path}, opts), do: {path, Keyword.get(opts, :resume_offset, 0)}
+  defp nif_sink({:fwup, _exe, args}, _opts), do: {List.last(args), 0}
+
+  defp find_fwup(nil) do
+    case System.find_executable("fwup") do
+      nil -> {:error, :fwup_not_found}
+      exe -> {:ok, exe}
+    end
+  end
+
+  defp find_fwup(exe) do
+    if File.regular?(exe), do: {:ok, exe}, else: {:error, :fwup_not_found}
+  end
+
+  defp ensure_fifo(fifo) do
+    case File.stat(fifo) do
+      {:ok, %File.Stat{type: :other}} ->
+        :ok
+
+      {:ok, _stat} ->
+        {:error, :not_a_fifo}
+
+      {:error, :enoent} ->
+        case System.cmd("mkfifo", ["-m", "600", fifo], stderr_to_stdout: true) do
+          {_output, 0} -> :ok
+          {_output, _status} -> {:error, :mkfifo_failed}
+        end
+
+      {:error, reason} ->
+        {:error, reason}
+    end
+  end
+
+  defp stop_stream(pid) do
+    Process.unlink(pid)
+    send(pid, :stop)
+    :ok
+  end
+
+  defp stream_init(owner, handler, sink) do
+    ref = Process.monitor(owner)
+    stream_loop(ref, handler, sink, open_fwup(sink))
+  end
+
+  # fwup blocks opening the FIFO until a download opens the other end
+  defp open_fwup({:fwup, exe, args}) do
+    Port.open({:spawn_executable, exe}, [:binary, :exit_status, :stderr_to_stdout, args: args])
+  end
+
+  defp open_fwup({:file, _path}), do: nil
+
+  defp stream_loop(ref, handler, sink, port) do
+    receive do
+      {:matter_ota, event, info} ->
+        handle_event(handler, event, info)
+        stream_loop(ref, handler, sink, port)
+
+      {^port, {:data, output}} ->
+        Logger.debug("Matter OTA fwup: #{String.trim(output)}")
+        stream_loop(ref, handler, sink, port)
+
+      {^port, {:exit_status, status}} ->
+        if status == 0 do
+          Logger.info("Matter OTA: fwup wrote the update")
+        else
+          Logger.warning("Matter OTA: fwup exited with status #{status}")
+        end
+
+        Process.send_after(self(), :open_fwup, @restart_delay)
+        stream_loop(ref, handler, sink, nil)
+
+      :open_fwup ->
+        stream_loop(ref, handler, sink, open_fwup(sink))
+
+      :stop ->
+        close_fwup(port)
+
+      {:DOWN, ^ref, :process, _pid, _reason} ->
+        close_fwup(port)
+    end
+  end
+
+  defp close_fwup(nil), do: :ok
+
+  # Closing the port alone would leave fwup waiting on the FIFO
+  defp close_fwup(port) do
+    case Port.info(port, :os_pid) do
+      {:os_pid, os_pid} -> System.cmd("kill", [Integer.to_string(os_pid)])
+      nil -> :ok
+    end
+
+    Port.close(port)
+    :ok
+  catch
+    :error, :badarg -> :ok
+  end
+
+  defp handle_event(handler, event, info) do
+    if handler && function_exported?(handler, :handle_ota_event, 2) do
+      handler.handle_ota_event(event, info)
+    else
+      log_event(event, info)
+    end
+  catch
+    kind, reason ->
+      Logger.error(
+        "Matter OTA handler failed for #{inspect(event)}: " <>
+          Exception.format(kind, reason, __STACKTRACE__)
+      )
+  end
+
+  defp log_event(:error, info), do: Logger.warning("Matter OTA: #{inspect(info.reason)}")
+  defp log_event(:progress, _info), do: :ok
+  defp log_event(:apply, _info), do: Logger.info("Matter OTA: update ready, reboot to apply")
+  defp log_event(event, info), do: Logger.info("Matter OTA: #{event} at #{info.offset}")
+end
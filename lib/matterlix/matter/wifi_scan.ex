@@ -0,0 +1,95 @@
+defmodule Matterlix.Matter.WiFiScan do
+  @moduledoc """
+  Packs WiFi scan results for `Matterlix.Matter.NIF.nif_wifi_scan_result/3`.
+
+  When a commissioner asks for a network scan, `Matterlix.Matter` has
+  VintageNet scan `wlan0` and hands the access points it finds to the NIF
+  as one binary, a record per network:
+
+      <<security::8, band::8, channel::16-big, rssi::signed-8,
+        bssid::binary-size(6), ssid_size::8, ssid::binary-size(ssid_size)>>
+
+  `security` is the Network Commissioning `WiFiSecurityBitmap` and `band`
+  its `WiFiBandEnum`. The NIF decodes the batch once into the iterator it
+  returns to the SDK, so reporting a scan costs one NIF call whatever the
+  number of networks.
+  """
+
+  import Bitwise
+
+  # Network Commissioning WiFiSecurityBitmap
+  @unencrypted 0x01
+  @wep 0x02
+  @wpa_personal 0x04
+  @wpa2_personal 0x08
+  @wpa3_personal 0x10
+
+  # Network Commissioning WiFiBandEnum
+  @bands %{wifi_2_4_ghz: 0, wifi_5_ghz: 2, wifi_6_ghz: 3}
+
+  # Limits of the NIF's scan result iterator
+  @max_results 64
+  @max_ssid 32
+
+  @doc """
+  Pack access points for the NIF.
+
+  `access_points` are `VintageNetWiFi.AccessPoint` structs, or maps with
+  the same `:ssid`, `:bssid`, `:band`, `:channel`, `:signal_dbm` and
+  `:flags` keys. With a `filter` SSID only that network is reported, as for
+  a directed scan. Hidden networks are skipped and, of the rest, the
+  #{@max_results} strongest are kept.
+  """
+  @spec encode([map()], binary() | nil) :: binary()
+  def encode(access_points, filter \\ nil) do
+    access_points
+    |> Enum.filter(&reportable?(&1, filter))
+    |> Enum.sort_by(& &1.signal_dbm, :desc)
+    |> Enum.take(@max_results)
+    |> Enum.map(&encode_record/1)
+    |> IO.iodata_to_binary()
+  end
+
+  defp reportable?(%{ssid: ssid}, _filter) when ssid in [nil, ""], do: false
+  defp reportable?(_access_point, nil), do: true
+  defp reportable?(%{ssid: ssid}, filter), do: ssid == filter
+
+  defp encode_record(access_point) do
+    ssid = binary_part(access_point.ssid, 0, min(byte_size(access_point.ssid), @max_ssid))
+
+    <<security(access_point.flags)::8, Map.get(@bands, access_point.band, 0)::8,
+      access_point.channel::16-big, clamp_rssi(access_point.signal_dbm)::signed-8,
+      bssid(access_point.bssid)::binary-size(6), byte_size(ssid)::8, ssid::binary>>
+  end
+
+  defp security(flags) do
+    names = Enum.map(flags, &Atom.to_string/1)
+
+    bits =
+      Enum.reduce(names, 0, fn name, bits ->
+        cond do
+          String.contains?(name, "sae") -> bits ||| @wpa3_personal
+          String.starts_with?(name, "wpa2_psk") -> bits ||| @wpa2_personal
+          String.starts_with?(name, "wpa_psk") -> bits ||| @wpa_personal
+          name == "wep" -> bits ||| @wep
+          true -> bits
+        end
+      end)
+
+    # The bitmap has no enterprise bit; still never report those as open
+    cond do
+      bits != 0 -> bits
+      Enum.any?(names, &String.contains?(&1, ["wpa", "rsn", "eap"])) -> @wpa2_personal
+      true -> @unencrypted
+    end
+  end
+
+  defp clamp_rssi(dbm), do: dbm |> max(-128) |> min(127)
+
+  defp bssid(bssid) when byte_size(bssid) == 6, do: bssid
+
+  defp bssid(bssid) do
+    bytes = for hex <- String.split(bssid, ":"), do: String.to_integer(hex, 16)
+    :erlang.list_to_binary(bytes)
+  end
+end
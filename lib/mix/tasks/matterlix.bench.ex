@@ -0,0 +1,133 @@
+defmodule Mix.Tasks.Matterlix.Bench do
+  @shortdoc "Benchmark the NIF and GenServer hot paths"
+  @moduledoc """
+  Runs `Matterlix.Bench` against the NIF built for the host (stub mode by
+  default) and prints a summary.
+
+  ## Usage
+
+      mix matterlix.bench                               # All benchmarks
+      mix matterlix.bench --iterations 50000            # More operations per benchmark
+      mix matterlix.bench --only nif.,change.           # Benchmarks by name prefix
+      mix matterlix.bench --concurrency 1,4,16          # Process counts to scale over
+      mix matterlix.bench --output bench.json           # Also write machine-readable JSON
+      mix matterlix.bench --native                      # Add the native microbenchmarks
+
+  ## Native microbenchmarks
+
+  `--native` builds `make bench` (the NIF source compiled into a standalone
+  binary) and adds its results under `"native"`. They cover the
+  parts that run without the VM: the global mutex and stack lock, the stub
+  attribute store, the change filter, the event queue ring, the statistics
+  histograms and the coalescing key-value store. `--native-iterations` sets their iteration count
+  (default: 1000000).
+
+  For an arm64 target, cross-compile the binary with
+  `make bench CROSSCOMPILE=1 CROSSCOMPILE_PREFIX=aarch64-linux-gnu-` (or
+  inside `docker/Dockerfile.arm64`) and run it on the device; on the device
+  itself run `Matterlix.Bench.run(output: path)` from IEx.
+  """
+
+  use Mix.Task
+
+  @switches [
+    iterations: :integer,
+    concurrency: :string,
+    only: :string,
+    output: :string,
+    native: :boolean,
+    native_iterations: :integer
+  ]
+
+  @impl Mix.Task
+  def run(args) do
+    {opts, _, _} =
+      OptionParser.parse(args, strict: @switches, aliases: [n: :iterations, o: :output])
+
+    Mix.Task.run("app.start")
+
+    report =
+      [
+        iterations: opts[:iterations],
+        concurrency: split(opts[:concurrency], &String.to_integer/1),
+        only: split(opts[:only], & &1)
+      ]
+      |> Enum.reject(fn {_key, value} -> is_nil(value) end)
+      |> Matterlix.Bench.run()
+
+    report =
+      if opts[:native] do
+        Map.put(report, :native, run_native(opts[:native_iterations] || 1_000_000))
+      else
+        report
+      end
+
+    print_report(report)
+
+    if path = opts[:output] do
+      File.write!(path, JSON.encode!(report))
+      Mix.shell().info("\nWrote #{path}")
+    end
+  end
+
+  defp split(nil, _fun), do: nil
+  defp split(value, fun), do: value |> String.split(",", trim: true) |> Enum.map(fun)
+
+  defp run_native(iterations) do
+    app_path = Mix.Project.app_path()
+    env = [{"MIX_APP_PATH", app_path}]
+
+    case System.cmd("make", ["bench"], env: env, stderr_to_stdout: true) do
+      {_output, 0} -> :ok
+      {output, _status} -> Mix.raise("make bench failed:\n#{output}")
+    end
+
+    binary = Path.join([app_path, "obj", "matter_nif_bench"])
+
+    case System.cmd(binary, [Integer.to_string(iterations)]) do
+      {output, 0} -> output |> JSON.decode!() |> Map.fetch!("results")
+      {output, status} -> Mix.raise("#{binary} exited with #{status}:\n#{output}")
+    end
+  end
+
+  defp print_report(report) do
+    system = report.system
+
+    Mix.shell().info(
+      "matterlix #{system.matterlix} on #{system.arch}, OTP #{system.otp}, " <>
+        "#{system.schedulers} schedulers, sdk_enabled: #{system.sdk_enabled}\n"
+    )
+
+    Enum.each(report.results, &print_result/1)
+
+    for result <- Map.get(report, :native, []) do
+      Mix.shell().info(
+        pad("native.#{result["name"]}", result["threads"]) <>
+          "#{format(result["ns_per_op"])} ns/op  #{format(result["ops_per_sec"])} ops/s"
+      )
+    end
+  end
+
+  defp print_result(%{skipped: reason} = result) do
+    Mix.shell().info(pad(result.name, 1) <> "skipped (#{reason})")
+  end
+
+  defp print_result(%{ops_per_sec: _} = result) do
+    latency = result.latency_us
+
+    Mix.shell().info(
+      pad(result.name, result.processes) <>
+        "#{format(result.ops_per_sec)} ops/s  p50 #{latency.p50}us  " <>
+        "p99 #{latency.p99}us  max #{latency.max}us"
+    )
+  end
+
+  defp print_result(result) do
+    Mix.shell().info(pad(result.name, result.processes) <> "#{result.latency_us.total}us")
+  end
+
+  defp pad(name, parallelism), do: String.pad_trailing("#{name} x#{parallelism}", 48)
+
+  defp format(number) when is_float(number), do: :erlang.float_to_binary(number, decimals: 1)
+  defp format(number), do: to_string(number)
+end
@@ -8,6 +8,7 @@ defmodule Mix.Tasks.Matterlix.BuildSdk do
       mix matterlix.build_sdk                    # Uses configured or default (:light) profile
       mix matterlix.build_sdk --profile lock      # Build for a specific profile
       mix matterlix.build_sdk --list              # List available profiles
+      mix matterlix.build_sdk -p bridge --config dynamic_endpoints=64  # Override a pool size
 
   ## Configuration
 
@@ -15,6 +16,14 @@ defmodule Mix.Tasks.Matterlix.BuildSdk do
 
       config :matterlix, device_profile: :light
 
+  ## Pool sizes
+
+  The profile's `:sdk_config` (see `Matterlix.DeviceProfiles`) sets the
+  Matter stack's pool sizes. Each `--config key=value` overrides one of them
+  for this build. The SDK and the NIF both pick the values up from a header
+  generated into the build's `gen/include`, so changing them only needs
+  this task to be run again.
+
   ## Requirements
 
   - Docker must be installed and running
@@ -39,7 +48,7 @@ defmodule Mix.Tasks.Matterlix.BuildSdk do
   def run(args) do
     {opts, _, _} =
       OptionParser.parse(args,
-        switches: [profile: :string, list: :boolean],
+        switches: [profile: :string, list: :boolean, config: :keep],
         aliases: [p: :profile, l: :list]
       )
 
@@ -47,7 +56,31 @@ defmodule Mix.Tasks.Matterlix.BuildSdk do
       list_profiles()
     else
       profile_name = resolve_profile(opts[:profile])
-      build_sdk(profile_name)
+      overrides = opts |> Keyword.get_values(:config) |> Enum.map(&parse_config/1)
+      build_sdk(profile_name, overrides)
+    end
+  end
+
+  defp parse_config(option) do
+    with [key, value] <- String.split(option, "=", parts: 2),
+         key when not is_nil(key) <- config_key(key) do
+      {key, config_value(value)}
+    else
+      _ -> Mix.raise("Invalid --config #{option}, expected key=value")
+    end
+  end
+
+  defp config_key(name) do
+    Enum.find(@profiles_module.sdk_config_keys(), &(Atom.to_string(&1) == name))
+  end
+
+  defp config_value("true"), do: true
+  defp config_value("false"), do: false
+
+  defp config_value(value) do
+    case Integer.parse(value) do
+      {integer, ""} -> integer
+      _ -> value
     end
   end
 
@@ -60,6 +93,11 @@ defmodule Mix.Tasks.Matterlix.BuildSdk do
       Mix.shell().info("  #{name}")
       Mix.shell().info("    #{profile.description}")
       Mix.shell().info("    GN root: #{profile.gn_root}")
+
+      if config = profile[:sdk_config] do
+        Mix.shell().info("    SDK config: #{inspect(config)}")
+      end
+
       Mix.shell().info("")
     end)
   end
@@ -80,8 +118,14 @@ defmodule Mix.Tasks.Matterlix.BuildSdk do
     atom
   end
 
-  defp build_sdk(profile_name) do
+  defp build_sdk(profile_name, overrides) do
     profile = @profiles_module.get!(profile_name)
+
+    defines =
+      profile
+      |> Map.get(:sdk_config, [])
+      |> Keyword.merge(overrides)
+      |> sdk_config_defines()
     sdk_path = Path.expand("deps/connectedhomeip")
     project_root = File.cwd!()
 
@@ -93,11 +137,15 @@ defmodule Mix.Tasks.Matterlix.BuildSdk do
     Mix.shell().info("  GN root: #{profile.gn_root}")
     Mix.shell().info("  Executable: #{profile.executable}")
 
+    if defines != [] do
+      Mix.shell().info("  SDK config: #{Enum.join(defines, " ")}")
+    end
+
     # Step 1: Ensure Docker image is built
     ensure_docker_image(project_root)
 
     # Step 2: Run Docker build with profile env vars
-    run_docker_build(sdk_path, project_root, profile_name, profile)
+    run_docker_build(sdk_path, project_root, profile_name, profile, defines)
 
     # Step 3: Generate matter_sdk_includes.mk
     build_dir = Path.join(sdk_path, "out/linux-arm64-#{profile_name}")
@@ -146,7 +194,13 @@ defmodule Mix.Tasks.Matterlix.BuildSdk do
     end
   end
 
-  defp run_docker_build(sdk_path, _project_root, profile_name, profile) do
+  defp sdk_config_defines(config) do
+    @profiles_module.sdk_config_defines(config)
+  rescue
+    e in ArgumentError -> Mix.raise(Exception.message(e))
+  end
+
+  defp run_docker_build(sdk_path, _project_root, profile_name, profile, defines) do
     Mix.shell().info("\nStarting Matter SDK build in Docker...")
     Mix.shell().info("This may take 20-30 minutes for the first build.\n")
 
@@ -163,6 +217,8 @@ defmodule Mix.Tasks.Matterlix.BuildSdk do
       "MATTER_OUTPUT_NAME=#{profile_name}",
       "-e",
       "MATTER_EXECUTABLE=#{profile.executable}",
+      "-e",
+      "MATTER_CONFIG_DEFINES=#{Enum.join(defines, " ")}",
       @docker_image
     ]
 
@@ -0,0 +1,42 @@
+defmodule Matterlix.BenchTest do
+  use ExUnit.Case, async: false
+
+  @tag :tmp_dir
+  test "run reports every benchmark and writes JSON", %{tmp_dir: tmp_dir} do
+    path = Path.join(tmp_dir, "bench.json")
+    report = Matterlix.Bench.run(iterations: 20, concurrency: [1, 2], output: path)
+
+    assert %{schema: 1, system: %{sdk_enabled: false}, results: results} = report
+
+    names = results |> Enum.map(& &1.name) |> Enum.uniq()
+
+    for name <- ~w(startup nif.set_attribute nif.get_attribute nif.set_attribute_async
+                   genserver.set_attribute genserver.get_attribute cache.get_attribute
+                   change.handler_latency
+                   concurrency.nif_get_attribute concurrency.genserver_get_attribute
+                   concurrency.direct_get_attribute concurrency.nif_set_get_attribute
+                   bridge.add_endpoints) do
+      assert name in names
+    end
+
+    scaling = Enum.filter(results, &(&1.name == "concurrency.nif_get_attribute"))
+    assert Enum.map(scaling, & &1.processes) == [1, 2]
+    assert [%{speedup: 1.0}, %{speedup: speedup}] = scaling
+    assert speedup > 0
+
+    set = Enum.find(results, &(&1.name == "nif.set_attribute"))
+    assert set.ops == 20 and set.ops_per_sec > 0
+    assert set.latency_us.p50 <= set.latency_us.p99
+
+    bridge = Enum.find(results, &(&1.name == "bridge.add_endpoints"))
+    assert bridge.ops == 200
+    assert bridge.arena_bytes == 200 * bridge.bytes_per_endpoint
+
+    assert %{"schema" => 1, "results" => [_ | _]} = path |> File.read!() |> JSON.decode!()
+  end
+
+  test "only selects benchmarks by prefix" do
+    report = Matterlix.Bench.run(iterations: 5, only: ["nif.get"])
+    assert [%{name: "nif.get_attribute"}] = report.results
+  end
+end
@@ -3,6 +3,8 @@ defmodule Matterlix.DeviceProfilesTest do
 
   alias Matterlix.DeviceProfiles
 
+  doctest DeviceProfiles
+
   describe "get!/1" do
     test "returns profile for valid name" do
       profile = DeviceProfiles.get!(:light)
@@ -40,7 +42,8 @@ defmodule Matterlix.DeviceProfilesTest do
       assert Map.has_key?(profiles, :thermostat)
       assert Map.has_key?(profiles, :air_quality_sensor)
       assert Map.has_key?(profiles, :all_clusters)
-      assert map_size(profiles) == 6
+      assert Map.has_key?(profiles, :bridge)
+      assert map_size(profiles) == 7
     end
 
     test "all profiles have required keys" do
@@ -67,4 +70,37 @@ defmodule Matterlix.DeviceProfilesTest do
       refute DeviceProfiles.valid?(:foo)
     end
   end
+
+  describe "sdk_config_defines/1" do
+    test "maps every profile's SDK config to CHIP defines" do
+      for {_name, profile} <- DeviceProfiles.list() do
+        for define <- DeviceProfiles.sdk_config_defines(Map.get(profile, :sdk_config, [])) do
+          assert define =~ ~r/^CHIP_[A-Z_]+=\d+$/
+        end
+      end
+
+      assert DeviceProfiles.sdk_config_defines(DeviceProfiles.get!(:bridge).sdk_config) == [
+               "CHIP_DEVICE_CONFIG_DYNAMIC_ENDPOINT_COUNT=256"
+             ]
+    end
+
+    test "accepts zero only where it means something" do
+      assert ["CHIP_SYSTEM_CONFIG_PACKETBUFFER_POOL_SIZE=0"] =
+               DeviceProfiles.sdk_config_defines(packet_buffers: 0)
+
+      assert_raise ArgumentError, ~r/Invalid value/, fn ->
+        DeviceProfiles.sdk_config_defines(fabrics: 0)
+      end
+
+      assert_raise ArgumentError, ~r/Invalid value/, fn ->
+        DeviceProfiles.sdk_config_defines(statistics: 1)
+      end
+    end
+
+    test "rejects unknown keys" do
+      assert_raise ArgumentError, ~r/Unknown SDK config key: :heap/, fn ->
+        DeviceProfiles.sdk_config_defines(heap: 1024)
+      end
+    end
+  end
 end
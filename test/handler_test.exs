@@ -44,6 +44,32 @@ defmodule Matterlix.HandlerTest do
       Application.delete_env(:matterlix, :handler)
     end
 
+    test "attribute_changes batches dispatch each change in order" do
+      {:ok, agent} = Agent.start_link(fn -> [] end)
+
+      handler_mod = create_capturing_handler(agent)
+
+      Application.put_env(:matterlix, :handler, handler_mod)
+
+      name = :"handler_batch_#{System.unique_integer([:positive])}"
+      {:ok, pid} = Matterlix.Matter.start_link(name: name)
+
+      changes = [
+        {1, 0x0006, 0x0000, 0x10, true},
+        {1, 0x0008, 0x0000, 0x20, 128}
+      ]
+
+      send(pid, {:attribute_changes, changes})
+      Process.sleep(50)
+
+      calls = Agent.get(agent, & &1)
+      assert ^changes = calls
+
+      GenServer.stop(pid)
+      Agent.stop(agent)
+      Application.delete_env(:matterlix, :handler)
+    end
+
     test "handler errors are logged but don't crash the GenServer" do
       Application.put_env(:matterlix, :handler, ErrorHandler)
 
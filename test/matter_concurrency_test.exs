@@ -140,4 +140,82 @@ defmodule Matterlix.Matter.ConcurrencyTest do
       assert info.has_listener == true
     end
   end
+
+  describe "lifecycle under load" do
+    # uint16 attributes of the stub layout, one per writer
+    @paths [{1, 0x0003, 0x0000}, {1, 0x0006, 0x4001}, {1, 0x0006, 0x4002}, {1, 0x0300, 0x0007}]
+
+    @tag timeout: 30_000
+    test "attribute writers read back their own values through start and stop" do
+      {:ok, ctx} = NIF.nif_init()
+      initial = for {e, c, a} <- @paths, do: NIF.nif_get_attribute(ctx, e, c, a)
+      lifecycle = Task.async(fn -> start_stop(ctx, 200) end)
+
+      # Each writer owns one path, so every read must return its last write
+      writes =
+        @paths
+        |> Enum.map(fn {e, c, a} ->
+          Task.async(fn ->
+            call_until(System.monotonic_time(:millisecond) + 300, 0, fn i ->
+              value = rem(i, 60_000)
+              :ok = NIF.nif_set_attribute(ctx, e, c, a, value)
+              {:ok, ^value} = NIF.nif_get_attribute(ctx, e, c, a)
+            end)
+          end)
+        end)
+        |> Task.await_many(10_000)
+
+      assert :ok = Task.await(lifecycle, 20_000)
+      assert Enum.all?(writes, &(&1 > 0))
+
+      for {{e, c, a}, {:ok, value}} <- Enum.zip(@paths, initial) do
+        :ok = NIF.nif_set_attribute(ctx, e, c, a, value)
+      end
+    end
+
+    @tag timeout: 30_000
+    test "server state stays consistent through start and stop" do
+      {:ok, ctx} = NIF.nif_init()
+      lifecycle = Task.async(fn -> start_stop(ctx, 200) end)
+
+      tasks =
+        for _ <- 1..4 do
+          Task.async(fn ->
+            call_until(System.monotonic_time(:millisecond) + 300, 0, fn _i ->
+              {:ok, %{server_started: started, initialized: true}} = NIF.nif_get_info(ctx)
+              true = is_boolean(started)
+            end)
+          end)
+        end
+
+      reads = Task.await_many(tasks, 10_000)
+
+      assert :ok = Task.await(lifecycle, 20_000)
+      assert Enum.all?(reads, &(&1 > 0))
+      assert {:ok, %{server_started: false, initialized: true}} = NIF.nif_get_info(ctx)
+    end
+  end
+
+  # Start and stop the server `cycles` times; a context created while it
+  # runs sees it running
+  defp start_stop(ctx, cycles) do
+    for _ <- 1..cycles do
+      :ok = NIF.nif_start_server(ctx)
+      {:ok, other} = NIF.nif_init()
+      {:ok, %{server_started: true}} = NIF.nif_get_info(other)
+      :ok = NIF.nif_stop_server(ctx)
+    end
+
+    :ok
+  end
+
+  # Calls `fun` with a counter until `deadline` and returns the number of calls
+  defp call_until(deadline, count, fun) do
+    if System.monotonic_time(:millisecond) < deadline do
+      fun.(count)
+      call_until(deadline, count + 1, fun)
+    else
+      count
+    end
+  end
 end
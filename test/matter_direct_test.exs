@@ -0,0 +1,81 @@
+defmodule Matterlix.Matter.DirectTest do
+  use ExUnit.Case, async: false
+  alias Matterlix.Matter
+  alias Matterlix.Matter.Direct
+
+  setup do
+    name = :"matter_direct_#{System.unique_integer([:positive])}"
+    {:ok, pid} = Matter.start_link(name: name)
+
+    on_exit(fn ->
+      if Process.alive?(pid), do: GenServer.stop(pid, :normal, 1000)
+    end)
+
+    {:ok, pid: pid, name: name}
+  end
+
+  test "reads and writes without calling the server", %{pid: pid, name: name} do
+    :sys.suspend(pid)
+
+    try do
+      assert :ok = Direct.set_attribute(name, 1, 0x0300, 0x0007, 321)
+      assert {:ok, 321} = Direct.get_attribute(name, 1, 0x0300, 0x0007)
+      assert {:ok, 321} = Direct.get_attribute(pid, 1, 0x0300, 0x0007)
+
+      assert {:ok, [:ok]} = Direct.set_attributes(name, [{1, 0x0008, 0x0000, 40}])
+      assert {:ok, %{0x0000 => 40}} = Direct.read_cluster(name, 1, 0x0008)
+
+      assert {:ok, handle} = Direct.resolve_attribute(name, 1, 0x0008, 0x0000)
+      assert :ok = Direct.set_attribute(name, handle, 41)
+      assert {:ok, 41} = Direct.get_attribute(name, handle)
+    after
+      :sys.resume(pid)
+    end
+  end
+
+  test "errors come from the NIF", %{name: name} do
+    assert {:error, :invalid_endpoint_id} = Direct.set_attribute(name, 0x10000, 6, 0, true)
+    assert {:error, :attribute_not_found} = Direct.get_attribute(name, 1, 0x0006, 0x7777)
+  end
+
+  test "writes reach the server's change notifications", %{pid: pid, name: name} do
+    :erlang.trace(pid, true, [:receive])
+    assert :ok = Direct.set_attribute(name, 1, 0x0006, 0x0000, false)
+    assert :ok = Direct.set_attribute(name, 1, 0x0006, 0x0000, true)
+
+    assert_receive {:trace, ^pid, :receive, {:attribute_changed, 1, 0x0006, 0x0000, _, true}}
+  end
+
+  test "reads see their own writes with the attribute cache enabled" do
+    name = :"matter_direct_cache_#{System.unique_integer([:positive])}"
+    {:ok, pid} = Matter.start_link(name: name, attribute_cache: true)
+
+    try do
+      assert :ok = Direct.set_attribute(name, 1, 0x0008, 0x0000, 10)
+      assert {:ok, 10} = Matter.get_attribute(name, 1, 0x0008, 0x0000)
+
+      :sys.suspend(pid)
+      assert :ok = Direct.set_attribute(name, 1, 0x0008, 0x0000, 20)
+      assert {:ok, 20} = Direct.get_attribute(name, 1, 0x0008, 0x0000)
+      :sys.resume(pid)
+    after
+      GenServer.stop(pid)
+    end
+  end
+
+  test "the default server is Matterlix.Matter" do
+    {:ok, pid} = Matter.start_link(name: Matter)
+
+    try do
+      assert {:ok, _value} = Direct.get_attribute(1, 0x0006, 0x0000)
+    after
+      GenServer.stop(pid)
+    end
+  end
+
+  test "returns :not_running without a server", %{pid: pid, name: name} do
+    GenServer.stop(pid)
+    assert {:error, :not_running} = Direct.get_attribute(name, 1, 0x0006, 0x0000)
+    assert {:error, :not_running} = Direct.set_attribute(name, 1, 0x0006, 0x0000, true)
+  end
+end
@@ -0,0 +1,159 @@
+defmodule Matterlix.Matter.DispatcherTest do
+  use ExUnit.Case, async: false
+  alias Matterlix.Matter
+  alias Matterlix.Matter.Dispatcher
+
+  defmodule TestHandler do
+    @behaviour Matterlix.Handler
+
+    @impl true
+    def handle_attribute_change(endpoint_id, _cluster_id, _attribute_id, _type, value) do
+      send(:persistent_term.get({__MODULE__, :listener}), {:handled, self(), endpoint_id, value})
+
+      case value do
+        :block ->
+          receive do
+            :continue -> :ok
+          end
+
+        :raise ->
+          raise "handler failure"
+
+        _ ->
+          :ok
+      end
+    end
+
+    @impl true
+    def handle_commissioning_complete(_fabric_index), do: :ok
+  end
+
+  setup do
+    :persistent_term.put({TestHandler, :listener}, self())
+    on_exit(fn -> :persistent_term.erase({TestHandler, :listener}) end)
+  end
+
+  defp change(endpoint_id, value), do: {endpoint_id, 0x0006, 0x0000, 0x10, value}
+
+  test "keeps order within a partition" do
+    {:ok, dispatcher} = Dispatcher.start_link(TestHandler, partitions: 2)
+
+    for i <- 1..20, do: :ok = Dispatcher.dispatch(dispatcher, change(1, i))
+
+    for i <- 1..20, do: assert_receive({:handled, _, 1, ^i})
+    Dispatcher.stop(dispatcher)
+  end
+
+  test "a blocked partition does not hold up the others" do
+    {:ok, dispatcher} =
+      Dispatcher.start_link(TestHandler, partitions: 2, key: fn ep, _, _ -> ep end)
+
+    [blocked, other] = partition_endpoints(2)
+
+    :ok = Dispatcher.dispatch(dispatcher, change(blocked, :block))
+    assert_receive {:handled, worker, ^blocked, :block}
+
+    :ok = Dispatcher.dispatch(dispatcher, change(other, 1))
+    assert_receive {:handled, _, ^other, 1}
+
+    send(worker, :continue)
+    Dispatcher.stop(dispatcher)
+  end
+
+  test "sheds changes when a partition queue is full" do
+    {:ok, dispatcher} = Dispatcher.start_link(TestHandler, partitions: 1, max_queue: 2)
+
+    :ok = Dispatcher.dispatch(dispatcher, change(1, :block))
+    assert_receive {:handled, worker, 1, :block}
+    :ok = Dispatcher.dispatch(dispatcher, change(1, 1))
+    assert :dropped = Dispatcher.dispatch(dispatcher, change(1, 2))
+
+    assert [%{depth: 2, high_water: 2, dispatched: 2, dropped: 1}] = Dispatcher.stats(dispatcher)
+
+    send(worker, :continue)
+    assert_receive {:handled, ^worker, 1, 1}
+    refute_receive {:handled, _, 1, 2}, 50
+    assert [%{depth: 0}] = Dispatcher.stats(dispatcher)
+    Dispatcher.stop(dispatcher)
+  end
+
+  test "a raising handler does not stop the worker" do
+    {:ok, dispatcher} = Dispatcher.start_link(TestHandler, partitions: 1)
+
+    ExUnit.CaptureLog.capture_log(fn ->
+      :ok = Dispatcher.dispatch(dispatcher, change(1, :raise))
+      :ok = Dispatcher.dispatch(dispatcher, change(1, 1))
+      assert_receive {:handled, worker, 1, :raise}
+      assert_receive {:handled, ^worker, 1, 1}
+    end)
+
+    Dispatcher.stop(dispatcher)
+  end
+
+  test "rejects partition counts and queue limits below one" do
+    for opts <- [[partitions: 0], [partitions: -1], [partitions: 1.5], [max_queue: 0]] do
+      assert {:error, :badarg} = Dispatcher.start_link(TestHandler, opts)
+    end
+  end
+
+  test "workers exit with their owner" do
+    parent = self()
+
+    owner =
+      spawn(fn ->
+        {:ok, dispatcher} = Dispatcher.start_link(TestHandler, partitions: 2)
+        send(parent, {:dispatcher, dispatcher})
+
+        receive do
+          :exit -> :ok
+        end
+      end)
+
+    assert_receive {:dispatcher, dispatcher}
+    refs = dispatcher.workers |> Tuple.to_list() |> Enum.map(&Process.monitor/1)
+
+    send(owner, :exit)
+    for ref <- refs, do: assert_receive({:DOWN, ^ref, :process, _, _})
+  end
+
+  describe "Matterlix.Matter with :dispatch" do
+    test "changes reach the handler from a worker" do
+      name = :"matter_dispatch_#{System.unique_integer([:positive])}"
+      {:ok, pid} = Matter.start_link(name: name, handler: TestHandler, dispatch: [partitions: 2])
+
+      send(pid, {:attribute_changed, 1, 0x0006, 0x0000, 0x10, true})
+      send(pid, {:attribute_changes, [change(2, false)]})
+
+      assert_receive {:handled, worker, 1, true}
+      assert_receive {:handled, _, 2, false}
+      assert worker != pid
+
+      assert {:ok, [_, _] = partitions} = Matter.dispatch_stats(pid)
+      assert partitions |> Enum.map(& &1.dispatched) |> Enum.sum() == 2
+      GenServer.stop(pid)
+    end
+
+    test "invalid options leave the handler inline" do
+      name = :"matter_dispatch_#{System.unique_integer([:positive])}"
+
+      ExUnit.CaptureLog.capture_log(fn ->
+        {:ok, pid} = Matter.start_link(name: name, dispatch: [partitions: 0])
+        assert {:error, :inline} = Matter.dispatch_stats(pid)
+        GenServer.stop(pid)
+      end)
+    end
+
+    test "dispatch_stats without a dispatcher" do
+      {:ok, pid} = Matter.start_link(name: :"matter_inline_#{System.unique_integer([:positive])}")
+      assert {:error, :inline} = Matter.dispatch_stats(pid)
+      GenServer.stop(pid)
+    end
+  end
+
+  # Endpoints that land on different partitions
+  defp partition_endpoints(partitions) do
+    0..100
+    |> Enum.uniq_by(&:erlang.phash2(&1, partitions))
+    |> Enum.take(partitions)
+  end
+end
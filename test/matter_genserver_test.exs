@@ -1,6 +1,7 @@
 defmodule Matterlix.MatterTest do
   use ExUnit.Case, async: false
   alias Matterlix.Matter
+  alias Matterlix.Matter.NIF
 
   setup do
     # Start fresh GenServer for each test with a unique name to avoid conflicts
@@ -40,10 +41,30 @@ defmodule Matterlix.MatterTest do
     test "start_server/stop_server cycle", %{pid: pid} do
       assert :ok = Matter.start_server(pid)
       assert {:error, :already_started} = Matter.start_server(pid)
+      assert :ok = Matter.await_started(pid)
+      assert {:error, :already_started} = Matter.start_server(pid)
       assert :ok = Matter.stop_server(pid)
       assert {:error, :not_started} = Matter.stop_server(pid)
     end
 
+    test "timings include the start phases once started", %{pid: pid} do
+      :ok = Matter.start_server(pid)
+      :ok = Matter.await_started(pid)
+
+      assert {:ok, %{load: _, static_resources: _, event_loop: _}} = Matter.timings(pid)
+    end
+
+    test "stats reports NIF call counts", %{pid: pid} do
+      {:ok, _info} = Matter.get_info(pid)
+
+      assert {:ok, %{calls: %{nif_get_info: calls}}} = Matter.stats(pid)
+      assert calls >= 1
+    end
+
+    test "await_started without a start in progress", %{pid: pid} do
+      assert {:error, :not_started} = Matter.await_started(pid)
+    end
+
     test "get_info returns map", %{pid: pid} do
       {:ok, info} = Matter.get_info(pid)
       assert is_map(info)
@@ -68,6 +89,230 @@ defmodule Matterlix.MatterTest do
     end
   end
 
+  describe "attributes" do
+    test "set_attributes applies a batch", %{pid: pid} do
+      batch = [
+        {1, 0x0402, 0x0000, 2350},
+        {1, 0x0405, 0x0000, 4500}
+      ]
+
+      assert {:ok, [:ok, :ok]} = Matter.set_attributes(pid, batch)
+    end
+
+    test "set_attribute and get_attribute reply once the operation completes", %{pid: pid} do
+      assert :ok = Matter.set_attribute(pid, 1, 0x0006, 0x0000, true)
+      assert {:ok, _value} = Matter.get_attribute(pid, 1, 0x0006, 0x0000)
+      assert %{pending_replies: pending} = :sys.get_state(pid)
+      assert pending == %{}
+    end
+
+    test "invalid paths are rejected without waiting for a reply", %{pid: pid} do
+      assert {:error, :invalid_endpoint_id} = Matter.set_attribute(pid, 0x10000, 6, 0, true)
+    end
+
+    test "resolved handles work through the GenServer", %{pid: pid} do
+      assert {:ok, handle} = Matter.resolve_attribute(pid, 1, 0x0008, 0x0000)
+      assert :ok = Matter.set_attribute(pid, handle, 128)
+      assert {:ok, _value} = Matter.get_attribute(pid, handle)
+    end
+
+    test "read_cluster returns a map", %{pid: pid} do
+      assert {:ok, attributes} = Matter.read_cluster(pid, 1, 0x0008)
+      assert is_map(attributes)
+    end
+
+    test "write_transaction defers report marking to its end", %{pid: pid} do
+      :ok = Matter.set_attribute(pid, 1, 0x0402, 0x0000, 2000)
+
+      result =
+        Matter.write_transaction(pid, fn ->
+          {:ok, [:ok]} = Matter.set_attributes(pid, [{1, 0x0402, 0x0000, 2001}])
+          :ok = Matter.Direct.set_attribute(pid, 1, 0x0402, 0x0000, 2002)
+          assert {:ok, %{transactions: 1, pending: pending}} = Matter.report_stats(pid)
+          assert pending >= 1
+          :written
+        end)
+
+      assert result == :written
+      assert {:ok, %{transactions: 0, pending: 0}} = Matter.report_stats(pid)
+      assert %{write_transactions: open} = :sys.get_state(pid)
+      assert open == %{}
+    end
+
+    test "a transaction is committed when its caller exits", %{pid: pid} do
+      test = self()
+
+      caller =
+        spawn(fn ->
+          Matter.write_transaction(pid, fn ->
+            send(test, :in_transaction)
+            Process.sleep(:infinity)
+          end)
+        end)
+
+      assert_receive :in_transaction
+      assert {:ok, %{transactions: 1}} = Matter.report_stats(pid)
+
+      ref = Process.monitor(caller)
+      Process.exit(caller, :kill)
+      assert_receive {:DOWN, ^ref, :process, _, :killed}
+      :sys.get_state(pid)
+      assert {:ok, %{transactions: 0}} = Matter.report_stats(pid)
+    end
+  end
+
+  describe "attribute cache" do
+    setup do
+      name = :"matter_cache_#{System.unique_integer([:positive])}"
+      {:ok, pid} = Matter.start_link(name: name, attribute_cache: [volatile: [{1, 0x0402, :_}]])
+      on_exit(fn -> if Process.alive?(pid), do: GenServer.stop(pid, :normal, 1000) end)
+      {:ok, cached: pid, name: name}
+    end
+
+    test "reads are served from the cache after the first miss", %{cached: pid, name: name} do
+      assert :ok = Matter.set_attribute(pid, 1, 0x0300, 0x0007, 250)
+      assert {:ok, 250} = Matter.get_attribute(name, 1, 0x0300, 0x0007)
+
+      :sys.suspend(pid)
+
+      try do
+        assert {:ok, 250} = Matter.get_attribute(pid, 1, 0x0300, 0x0007)
+        assert {:ok, 250} = Matter.get_attribute(name, 1, 0x0300, 0x0007)
+      after
+        :sys.resume(pid)
+      end
+    end
+
+    test "change notifications update cached values", %{cached: pid} do
+      assert {:ok, _} = Matter.get_attribute(pid, 1, 0x0008, 0x0000)
+      send(pid, {:attribute_changed, 1, 0x0008, 0x0000, 0x20, 77})
+      send(pid, {:attribute_changes, [{1, 0x0006, 0x0000, 0x10, true}]})
+      :sys.get_state(pid)
+
+      assert {:ok, 77} = Matter.get_attribute(pid, 1, 0x0008, 0x0000)
+      assert {:ok, true} = Matter.get_attribute(pid, 1, 0x0006, 0x0000)
+    end
+
+    test "writes drop the entry", %{cached: pid} do
+      assert :ok = Matter.set_attribute(pid, 1, 0x0006, 0x0000, false)
+      assert {:ok, false} = Matter.get_attribute(pid, 1, 0x0006, 0x0000)
+      assert :ok = Matter.set_attribute(pid, 1, 0x0006, 0x0000, 1)
+
+      %{attribute_cache: cache} = :sys.get_state(pid)
+      assert :ets.lookup(cache.table, {1, 0x0006, 0x0000}) == []
+      assert {:ok, true} = Matter.get_attribute(pid, 1, 0x0006, 0x0000)
+    end
+
+    test "replies that trail a change notification do not replace it", %{cached: pid} do
+      path = {1, 0x0008, 0x0000}
+
+      for {request, expected} <- [
+            {fn -> Matter.set_attribute(pid, 1, 0x0008, 0x0000, 10) end, []},
+            {fn -> Matter.get_attribute(pid, 1, 0x0008, 0x0000) end, [{path, 77}]}
+          ] do
+        :sys.suspend(pid)
+        task = Task.async(request)
+        await_queued(pid)
+        send(pid, {:attribute_changed, 1, 0x0008, 0x0000, 0x20, 77})
+        :sys.resume(pid)
+        Task.await(task)
+
+        %{attribute_cache: cache} = :sys.get_state(pid)
+        assert :ets.lookup(cache.table, path) == expected
+      end
+    end
+
+    test "set_attributes reports invalid entries without failing the server", %{cached: pid} do
+      batch = [{1, 0x0006, 0x0000, true}, {:bad, 0x0006}]
+
+      assert {:ok, [:ok, {:error, :invalid_args}]} = Matter.set_attributes(pid, batch)
+      assert Process.alive?(pid)
+      assert {:ok, true} = Matter.get_attribute(pid, 1, 0x0006, 0x0000)
+    end
+
+    test "volatile attributes are never cached", %{cached: pid} do
+      assert {:ok, _} = Matter.get_attribute(pid, 1, 0x0402, 0x0000)
+      send(pid, {:attribute_changed, 1, 0x0402, 0x0000, 0x29, 2100})
+
+      %{attribute_cache: cache} = :sys.get_state(pid)
+      assert :ets.tab2list(cache.table) == []
+    end
+
+    test "stopping the server clears the cache", %{cached: pid} do
+      :ok = Matter.start_server(pid)
+      :ok = Matter.await_started(pid)
+      assert {:ok, _} = Matter.get_attribute(pid, 1, 0x0008, 0x0000)
+
+      :ok = Matter.stop_server(pid)
+      %{attribute_cache: cache} = :sys.get_state(pid)
+      assert :ets.tab2list(cache.table) == []
+    end
+
+    test "removing a bridged endpoint drops its cached values", %{cached: pid} do
+      :ok = Matter.configure_bridge(pid, 1)
+
+      try do
+        {:ok, ep} = Matter.add_bridged_endpoint(pid, {:on_off_light, "Porch", "zb-1"})
+        assert {:ok, "Porch"} = Matter.get_attribute(pid, ep, 0x0039, 0x0005)
+        assert :ok = Matter.remove_bridged_endpoint(pid, ep)
+
+        %{attribute_cache: cache} = :sys.get_state(pid)
+        assert :ets.match(cache.table, {{ep, :_, :_}, :_}) == []
+        assert {:error, :attribute_not_found} = Matter.get_attribute(pid, ep, 0x0039, 0x0005)
+        assert {:ok, %{endpoints: 0, capacity: 1}} = Matter.bridge_stats(pid)
+      after
+        Matter.configure_bridge(pid, 0)
+      end
+    end
+
+    test "the cache goes away with the server", %{cached: pid, name: name} do
+      GenServer.stop(pid)
+      assert Matter.published(name) == nil
+      assert Matter.published(pid) == nil
+    end
+
+    test "is disabled by default", %{pid: pid} do
+      assert %{attribute_cache: nil} = :sys.get_state(pid)
+    end
+  end
+
+  describe "change notifications" do
+    test "coalesce option enables the event queue" do
+      name = :"matter_coalesce_#{System.unique_integer([:positive])}"
+      {:ok, pid} = Matter.start_link(name: name, coalesce: [{{:_, 0x0008, :_}, 100}])
+
+      assert {:ok, %{enabled: true, coalesced: 0}} = Matter.event_queue_stats(pid)
+
+      # The queue is global to the NIF; switch it back off for other tests
+      NIF.nif_configure_event_queue(:sys.get_state(pid).context, 0, 0, 0)
+      GenServer.stop(pid)
+    end
+
+    test "set_coalescing and set_change_filter", %{pid: pid} do
+      assert :ok = Matter.set_coalescing(pid, [{{1, 0x0300, :_}, 50}])
+      assert {:error, :invalid_args} = Matter.set_coalescing(pid, [{{1, 0x0300, :_}, 0}])
+      assert :ok = Matter.set_coalescing(pid, [])
+
+      assert :ok = Matter.set_change_filter(pid, {:deny, [{:_, 0x0003, :_}]})
+      assert :ok = Matter.set_change_filter(pid, nil)
+    end
+
+    test "subscribers receive changes alongside the handler", %{pid: pid} do
+      :ok = Matter.set_attribute(pid, 1, 0x0402, 0x0000, 2100)
+      assert :ok = Matter.subscribe(pid, {:allow, [{1, 0x0402, :_}]})
+      assert {:ok, subscribers} = Matter.subscribers(pid)
+      assert self() in subscribers
+
+      :ok = Matter.set_attribute(pid, 1, 0x0402, 0x0000, 2150)
+      assert_receive {:attribute_changed, 1, 0x0402, 0x0000, _type, 2150}
+
+      assert :ok = Matter.unsubscribe(pid)
+      :ok = Matter.set_attribute(pid, 1, 0x0402, 0x0000, 2100)
+      refute_receive {:attribute_changed, 1, 0x0402, _, _, _}, 50
+      assert {:error, :not_subscribed} = Matter.unsubscribe(pid)
+    end
+  end
+
   describe "device management" do
     test "set_device_info succeeds", %{pid: pid} do
       assert :ok =
@@ -144,12 +389,121 @@ defmodule Matterlix.MatterTest do
     end
   end
 
+  describe "logging" do
+    test "the log option forwards SDK records to Logger", %{pid: other} do
+      name = :"matter_log_#{System.unique_integer([:positive])}"
+      {:ok, pid} = Matter.start_link(name: name, log: [interval: 5])
+
+      log =
+        ExUnit.CaptureLog.capture_log(fn ->
+          :ok = Matter.start_server(pid)
+          :ok = Matter.await_started(pid)
+          :ok = Matter.stop_server(pid)
+          Process.sleep(50)
+        end)
+
+      assert log =~ "Matter NIF: Start phase event_loop completed"
+      assert log =~ "Matter NIF: Server stopped"
+      assert {:ok, %{enabled: true, undelivered: 0}} = Matter.log_stats(pid)
+      assert :ok = Matter.set_log_levels(pid, :error, [{"DMG", :debug}])
+      assert {:error, :invalid_level} = Matter.set_log_levels(pid, :loud)
+      :ok = Matter.set_log_levels(pid, :info)
+
+      # Stopping the server hands SDK logging back to stdout
+      GenServer.stop(pid)
+      assert {:ok, %{enabled: false}} = Matter.log_stats(other)
+    end
+  end
+
+  describe "storage" do
+    test "the storage option opens the store at the next start" do
+      path = Path.join(System.tmp_dir!(), "matterlix_kvs_genserver_test.bin")
+      name = :"matter_storage_#{System.unique_integer([:positive])}"
+      {:ok, pid} = Matter.start_link(name: name, storage: [path: path, flush_interval: 1000])
+
+      on_exit(fn ->
+        {:ok, ctx} = NIF.nif_init()
+        NIF.nif_configure_storage(ctx, nil, 5000, nil)
+        File.rm(path)
+      end)
+
+      :ok = Matter.start_server(pid)
+      :ok = Matter.await_started(pid)
+      assert {:ok, %{enabled: true, open: true, path: ^path}} = Matter.storage_stats(pid)
+      :ok = Matter.stop_server(pid)
+      GenServer.stop(pid)
+    end
+  end
+
+  describe "ota" do
+    test "the ota option points downloads at the OTA process" do
+      path = Path.join(System.tmp_dir!(), "matterlix_ota_genserver_test.bin")
+      name = :"matter_ota_#{System.unique_integer([:positive])}"
+      {:ok, pid} = Matter.start_link(name: name, ota: [path: path, resume_offset: 512])
+
+      assert {:ok, %{enabled: true, sink: :file, resume_offset: 512}} = Matter.ota_stats(pid)
+
+      GenServer.stop(pid)
+      {:ok, ctx} = NIF.nif_init()
+      assert {:ok, %{enabled: false}} = NIF.nif_get_ota_stats(ctx)
+    end
+
+    test "a missing fwup leaves updates disabled", %{pid: other} do
+      name = :"matter_ota_#{System.unique_integer([:positive])}"
+
+      log =
+        ExUnit.CaptureLog.capture_log(fn ->
+          {:ok, pid} = Matter.start_link(name: name, ota: [fwup: "/nonexistent/fwup"])
+          assert {:ok, %{enabled: false}} = Matter.ota_stats(pid)
+          GenServer.stop(pid)
+        end)
+
+      assert log =~ "fwup_not_found"
+      assert {:ok, %{enabled: false}} = Matter.ota_stats(other)
+    end
+  end
+
+  describe "reattaching" do
+    test "a detached server is taken over by the next process", %{pid: pid} do
+      :ok = Matter.start_server(pid)
+      :ok = Matter.await_started(pid)
+      :ok = Matter.detach(pid)
+      GenServer.stop(pid)
+
+      name = :"matter_reattach_#{System.unique_integer([:positive])}"
+      {:ok, next} = Matter.start_link(name: name, auto_start: true)
+
+      assert {:ok, %{is_owner: true, server_started: true}} = Matter.get_info(next)
+      assert {:error, :already_started} = Matter.start_server(next)
+      assert :ok = Matter.stop_server(next)
+      GenServer.stop(next)
+    end
+
+    test "code_change fills in state added by a new version", %{pid: pid} do
+      :ok = :sys.suspend(pid)
+      :sys.replace_state(pid, &Map.delete(&1, :detached))
+      :ok = :sys.change_code(pid, Matter, "0.3.0", [])
+      :ok = :sys.resume(pid)
+
+      assert %Matter{detached: false} = :sys.get_state(pid)
+      assert {:ok, _info} = Matter.get_info(pid)
+    end
+  end
+
   describe "termination" do
     test "terminate stops server if started", %{pid: pid} do
       :ok = Matter.start_server(pid)
+      :ok = Matter.await_started(pid)
       # Normal stop should call terminate which stops the server
       GenServer.stop(pid, :normal)
       refute Process.alive?(pid)
     end
   end
+
+  defp await_queued(pid) do
+    unless match?({:message_queue_len, n} when n > 0, Process.info(pid, :message_queue_len)) do
+      Process.sleep(1)
+      await_queued(pid)
+    end
+  end
 end
@@ -0,0 +1,66 @@
+defmodule Matterlix.Matter.WiFiScanTest do
+  use ExUnit.Case, async: true
+  alias Matterlix.Matter.NIF
+  alias Matterlix.Matter.WiFiScan
+
+  defp access_point(ssid, signal_dbm, flags \\ [:wpa2_psk_ccmp, :ess]) do
+    %{
+      ssid: ssid,
+      bssid: "8c:3b:ad:c4:74:c2",
+      band: :wifi_2_4_ghz,
+      channel: 11,
+      signal_dbm: signal_dbm,
+      flags: flags
+    }
+  end
+
+  defp decode(<<>>), do: []
+
+  defp decode(
+         <<security, band, channel::16-big, rssi::signed-8, bssid::binary-size(6), size,
+           ssid::binary-size(size), rest::binary>>
+       ) do
+    [{ssid, security, band, channel, rssi, bssid} | decode(rest)]
+  end
+
+  test "packs each access point into one record" do
+    assert [{"Home", 0x08, 0, 11, -42, <<0x8C, 0x3B, 0xAD, 0xC4, 0x74, 0xC2>>}] =
+             decode(WiFiScan.encode([access_point("Home", -42)]))
+  end
+
+  test "maps security flags and bands" do
+    open = access_point("Open", -50, [:ess])
+    wep = access_point("Old", -50, [:wep, :ess])
+    mixed = access_point("Mixed", -50, [:wpa_psk_tkip, :wpa2_psk_ccmp, :ess])
+    wpa3 = %{access_point("New", -50, [:sae_ccmp, :ess]) | band: :wifi_5_ghz, channel: 36}
+    enterprise = access_point("Work", -50, [:wpa2_eap_ccmp, :ess])
+
+    assert [
+             {"Open", 0x01, 0, 11, _, _},
+             {"Old", 0x02, 0, 11, _, _},
+             {"Mixed", 0x0C, 0, 11, _, _},
+             {"New", 0x10, 2, 36, _, _},
+             {"Work", 0x08, 0, 11, _, _}
+           ] = decode(WiFiScan.encode([open, wep, mixed, wpa3, enterprise]))
+  end
+
+  test "keeps the strongest networks, skips hidden ones and applies the filter" do
+    points = [access_point("Weak", -80), access_point("", -30), access_point("Strong", -40)]
+
+    ssids = for {ssid, _, _, _, _, _} <- decode(WiFiScan.encode(points)), do: ssid
+    assert ["Strong", "Weak"] = ssids
+    assert [{"Weak", _, _, _, _, _}] = decode(WiFiScan.encode(points, "Weak"))
+    assert <<>> = WiFiScan.encode(points, "Missing")
+  end
+
+  test "stays within the NIF's limits" do
+    points = for i <- 1..100, do: access_point(String.duplicate("n", 40) <> "#{i}", -i)
+    results = WiFiScan.encode(points)
+
+    assert length(decode(results)) == 64
+    assert Enum.all?(decode(results), fn {ssid, _, _, _, _, _} -> byte_size(ssid) == 32 end)
+
+    {:ok, ctx} = NIF.nif_init()
+    assert :ok = NIF.nif_wifi_scan_result(ctx, 0, results)
+  end
+end
@@ -37,6 +37,87 @@ defmodule Matterlix.Matter.NIFTest do
       assert :ok = NIF.nif_start_server(ctx)
       assert :ok = NIF.nif_stop_server(ctx)
     end
+
+    test "a running server is not started again" do
+      {:ok, ctx} = NIF.nif_init()
+      :ok = NIF.nif_start_server(ctx)
+
+      assert {:error, :already_started} = NIF.nif_start_server(ctx)
+      assert :ok = NIF.nif_start_server_async(ctx)
+      assert_receive {:matter_started, {:error, :already_started}}
+
+      :ok = NIF.nif_stop_server(ctx)
+    end
+
+    test "start_server_async reports each phase, then the result" do
+      {:ok, ctx} = NIF.nif_init()
+      assert :ok = NIF.nif_start_server_async(ctx)
+
+      for phase <- [:static_resources, :commissionable_data, :config, :server_init, :event_loop] do
+        assert_receive {:matter_start_phase, ^phase, elapsed_us}
+        assert is_integer(elapsed_us) and elapsed_us >= 0
+      end
+
+      assert_receive {:matter_started, :ok}
+      assert :ok = NIF.nif_stop_server(ctx)
+    end
+
+    test "get_timings records lifecycle phases in order" do
+      {:ok, ctx} = NIF.nif_init()
+      :ok = NIF.nif_start_server(ctx)
+
+      assert {:ok, timings} = NIF.nif_get_timings(ctx)
+      assert %{load: load, init: init, server_init: server_init, event_loop: event_loop} = timings
+      assert load <= init and init <= server_init and server_init <= event_loop
+
+      :ok = NIF.nif_stop_server(ctx)
+    end
+  end
+
+  describe "runtime statistics" do
+    test "get_stats counts calls and histograms lock waits" do
+      {:ok, ctx} = NIF.nif_init()
+      {:ok, before} = NIF.nif_get_stats(ctx)
+
+      {:ok, _info} = NIF.nif_get_info(ctx)
+      {:ok, _info} = NIF.nif_get_info(ctx)
+
+      assert {:ok, stats} = NIF.nif_get_stats(ctx)
+      assert stats.calls.nif_get_info == before.calls.nif_get_info + 2
+      assert stats.calls.nif_get_stats >= 1
+
+      hist = stats.global_mutex_wait
+      assert hist.count > before.global_mutex_wait.count
+      assert length(hist.buckets) == 22
+      assert {1, _} = hd(hist.buckets)
+      assert {:infinity, _} = List.last(hist.buckets)
+      assert hist.count == Enum.sum(for {_upper, n} <- hist.buckets, do: n)
+
+      assert %{seen: _, filtered: _, sent: _, queued: _} = stats.attribute_changes
+      assert %{overflow: _, dropped: _} = stats.event_queue
+      assert is_integer(stats.env_alloc_failures)
+    end
+
+    test "get_memory_stats reports the process and the NIF's own buffers" do
+      {:ok, ctx} = NIF.nif_init()
+      :ok = NIF.nif_configure_event_queue(ctx, 100, 16, 5)
+
+      assert {:ok, memory} = NIF.nif_get_memory_stats(ctx)
+      assert %{rss_bytes: rss, rss_high_water_bytes: high_water} = memory.process
+      assert high_water >= rss
+
+      if match?({:unix, :linux}, :os.type()), do: assert(rss > 0)
+
+      # 128 ring slots of 32-byte records, plus 16 payload bytes per slot
+      assert memory.nif.event_queue_bytes == 128 * (32 + 16)
+      assert memory.nif.attribute_store_bytes > 0
+      assert is_integer(memory.nif.bridge_arena_bytes)
+      assert memory.nif.log_ring_bytes == 0
+      refute Map.has_key?(memory, :pools)
+
+      :ok = NIF.nif_configure_event_queue(ctx, 0, 0, 0)
+      assert {:ok, %{nif: %{event_queue_bytes: 0}}} = NIF.nif_get_memory_stats(ctx)
+    end
   end
 
   describe "callback registration" do
@@ -130,6 +211,34 @@ defmodule Matterlix.Matter.NIFTest do
       assert {:error, :invalid_discriminator} =
                NIF.nif_set_commissioning_info(ctx, 20_202_021, 5000)
     end
+
+    test "set_commissioning_info on a running server records the PIN for the next start" do
+      {:ok, ctx} = NIF.nif_init()
+      :ok = NIF.nif_start_server(ctx)
+
+      try do
+        assert :ok = NIF.nif_set_commissioning_info(ctx, 20_202_021, 3840)
+        assert :ok = NIF.nif_set_commissioning_info(ctx, 34_567_890, 1234)
+        assert {:error, :invalid_pin} = NIF.nif_set_commissioning_info(ctx, 0, 1234)
+      after
+        :ok = NIF.nif_stop_server(ctx)
+      end
+
+      assert :ok = NIF.nif_start_server(ctx)
+      assert :ok = NIF.nif_stop_server(ctx)
+    end
+
+    test "set_verifier_cache validates input" do
+      {:ok, ctx} = NIF.nif_init()
+
+      assert :ok = NIF.nif_set_verifier_cache(ctx, "/tmp/matterlix_verifier.bin", 1000)
+      assert :ok = NIF.nif_set_verifier_cache(ctx, nil, 1000)
+
+      assert {:error, :invalid_iterations} = NIF.nif_set_verifier_cache(ctx, nil, 999)
+      assert {:error, :invalid_iterations} = NIF.nif_set_verifier_cache(ctx, nil, 100_001)
+      assert {:error, :invalid_args} = NIF.nif_set_verifier_cache(ctx, "", 1000)
+      assert {:error, :invalid_args} = NIF.nif_set_verifier_cache(ctx, "bad\0path", 1000)
+    end
   end
 
   describe "device management" do
@@ -145,6 +254,854 @@ defmodule Matterlix.Matter.NIFTest do
     end
   end
 
+  describe "attributes" do
+    test "set_attributes returns a status per entry" do
+      {:ok, ctx} = NIF.nif_init()
+
+      batch = [
+        {1, 0x0006, 0x0000, true},
+        {1, 0x0008, 0x0000, 128}
+      ]
+
+      assert {:ok, [:ok, :ok]} = NIF.nif_set_attributes(ctx, batch)
+    end
+
+    test "set_attributes reports invalid entries without failing the batch" do
+      {:ok, ctx} = NIF.nif_init()
+
+      batch = [
+        {1, 0x0006, 0x0000, true},
+        {0x10000, 0x0006, 0x0000, true},
+        {:bad, 0x0006}
+      ]
+
+      assert {:ok, [:ok, {:error, :invalid_endpoint_id}, {:error, :invalid_args}]} =
+               NIF.nif_set_attributes(ctx, batch)
+    end
+
+    test "set_attributes accepts an empty batch" do
+      {:ok, ctx} = NIF.nif_init()
+      assert {:ok, []} = NIF.nif_set_attributes(ctx, [])
+    end
+
+    test "read_cluster returns an attribute map" do
+      {:ok, ctx} = NIF.nif_init()
+      assert {:ok, attributes} = NIF.nif_read_cluster(ctx, 1, 0x0008)
+      assert is_map(attributes)
+    end
+
+    test "read_cluster validates input" do
+      {:ok, ctx} = NIF.nif_init()
+      assert {:error, :invalid_args} = NIF.nif_read_cluster(ctx, -1, 0x0008)
+      assert {:error, :invalid_endpoint_id} = NIF.nif_read_cluster(ctx, 0x10000, 0x0008)
+    end
+
+    test "resolved handles read and write attributes" do
+      {:ok, ctx} = NIF.nif_init()
+      assert {:ok, handle} = NIF.nif_resolve_attribute(ctx, 1, 0x0008, 0x0000)
+      assert is_reference(handle)
+
+      assert :ok = NIF.nif_set_attribute_h(ctx, handle, 128)
+      assert {:ok, _value} = NIF.nif_get_attribute_h(ctx, handle)
+    end
+
+    test "handles become stale after the server stops" do
+      {:ok, ctx} = NIF.nif_init()
+      {:ok, handle} = NIF.nif_resolve_attribute(ctx, 1, 0x0008, 0x0000)
+
+      :ok = NIF.nif_stop_server(ctx)
+
+      assert {:error, :stale_handle} = NIF.nif_set_attribute_h(ctx, handle, 128)
+      assert {:error, :stale_handle} = NIF.nif_get_attribute_h(ctx, handle)
+    end
+
+    test "handle NIFs reject invalid handles" do
+      {:ok, ctx} = NIF.nif_init()
+      assert {:error, :invalid_handle} = NIF.nif_set_attribute_h(ctx, make_ref(), 1)
+      assert {:error, :invalid_handle} = NIF.nif_get_attribute_h(ctx, ctx)
+    end
+
+    test "set_attributes rejects non-list arguments" do
+      {:ok, ctx} = NIF.nif_init()
+      assert {:error, :invalid_args} = NIF.nif_set_attributes(ctx, :not_a_list)
+    end
+
+    test "stub store keeps typed values" do
+      {:ok, ctx} = NIF.nif_init()
+
+      assert :ok = NIF.nif_set_attribute(ctx, 1, 0x0008, 0x0000, 77)
+      assert {:ok, 77} = NIF.nif_get_attribute(ctx, 1, 0x0008, 0x0000)
+      assert :ok = NIF.nif_set_attribute(ctx, 1, 0x0008, 0x0000, nil)
+      assert {:ok, nil} = NIF.nif_get_attribute(ctx, 1, 0x0008, 0x0000)
+
+      assert :ok = NIF.nif_set_attribute(ctx, 0, 0x0028, 0x0005, "kitchen")
+      assert {:ok, "kitchen"} = NIF.nif_get_attribute(ctx, 0, 0x0028, 0x0005)
+
+      assert {:error, :invalid_value} = NIF.nif_set_attribute(ctx, 1, 0x0006, 0x0000, 300)
+      assert {:error, :invalid_value} = NIF.nif_set_attribute(ctx, 1, 0x0008, 0x0002, nil)
+    end
+
+    test "stub store rejects unknown paths" do
+      {:ok, ctx} = NIF.nif_init()
+
+      assert {:error, :attribute_not_found} = NIF.nif_get_attribute(ctx, 1, 0x0006, 0x0F00)
+      assert {:error, :attribute_not_found} = NIF.nif_set_attribute(ctx, 9, 0x0006, 0x0000, true)
+      assert {:error, :attribute_not_found} = NIF.nif_resolve_attribute(ctx, 1, 0x0101, 0x0000)
+      assert {:error, :cluster_not_found} = NIF.nif_read_cluster(ctx, 1, 0x0101)
+    end
+
+    test "stub writes report changed values" do
+      {:ok, ctx} = NIF.nif_init()
+      :ok = NIF.nif_register_callback(ctx)
+
+      {:ok, on} = NIF.nif_get_attribute(ctx, 1, 0x0006, 0x0000)
+      assert :ok = NIF.nif_set_attribute(ctx, 1, 0x0006, 0x0000, not on)
+      assert_receive {:attribute_changed, 1, 0x0006, 0x0000, 0x10, value}
+      assert value == not on
+
+      # Rewriting the current value is not a change
+      assert :ok = NIF.nif_set_attribute(ctx, 1, 0x0006, 0x0000, not on)
+      refute_receive {:attribute_changed, 1, 0x0006, 0x0000, _, _}, 50
+    end
+  end
+
+  describe "bridge" do
+    setup do
+      {:ok, ctx} = NIF.nif_init()
+
+      on_exit(fn ->
+        # Stopping removes the bridged endpoints; then free the arena
+        :ok = NIF.nif_stop_server(ctx)
+        :ok = NIF.nif_configure_bridge(ctx, 0, 2)
+      end)
+
+      %{ctx: ctx}
+    end
+
+    test "adding requires a configured arena", %{ctx: ctx} do
+      device = {:on_off_light, "Porch", "zb-1"}
+      assert {:error, :bridge_not_configured} = NIF.nif_add_bridged_endpoint(ctx, 1, device)
+    end
+
+    test "configure validates input", %{ctx: ctx} do
+      assert {:error, :invalid_endpoint_id} = NIF.nif_configure_bridge(ctx, 8, 1)
+      assert {:error, :invalid_endpoint_id} = NIF.nif_configure_bridge(ctx, 8, 0xFFFF)
+      assert {:error, :invalid_capacity} = NIF.nif_configure_bridge(ctx, 0xFFFF, 2)
+      assert {:error, :invalid_args} = NIF.nif_configure_bridge(ctx, -1, 2)
+    end
+
+    test "bulk add, read, write and remove", %{ctx: ctx} do
+      :ok = NIF.nif_configure_bridge(ctx, 256, 2)
+
+      devices =
+        for i <- 1..200 do
+          kind = Enum.at([:on_off_light, :dimmable_light, :temperature_sensor], rem(i, 3))
+          {kind, "Device #{i}", "uid-#{i}"}
+        end
+
+      assert {:ok, results} = NIF.nif_add_bridged_endpoints(ctx, 1, devices)
+      endpoints = for {:ok, endpoint_id} <- results, do: endpoint_id
+      assert length(endpoints) == 200
+      assert endpoints == Enum.to_list(2..201)
+
+      # Basic information is filled in from the device description
+      assert {:ok, "Device 2"} = NIF.nif_get_attribute(ctx, 3, 0x0039, 0x0005)
+      assert {:ok, "uid-2"} = NIF.nif_get_attribute(ctx, 3, 0x0039, 0x0012)
+      assert {:ok, true} = NIF.nif_get_attribute(ctx, 3, 0x0039, 0x0011)
+
+      # Each kind has its own clusters, starting from their initial values
+      assert {:ok, nil} = NIF.nif_get_attribute(ctx, 3, 0x0402, 0x0000)
+      assert :ok = NIF.nif_set_attribute(ctx, 3, 0x0402, 0x0000, 2150)
+      assert {:ok, 2150} = NIF.nif_get_attribute(ctx, 3, 0x0402, 0x0000)
+      assert {:ok, %{0x0000 => false, 0xFFFD => 6}} = NIF.nif_read_cluster(ctx, 2, 0x0006)
+      assert {:ok, 0xFE} = NIF.nif_get_attribute(ctx, 2, 0x0008, 0x0000)
+      assert {:error, :attribute_not_found} = NIF.nif_get_attribute(ctx, 4, 0x0402, 0x0000)
+
+      assert {:ok, stats} = NIF.nif_get_bridge_stats(ctx)
+      assert stats.capacity == 256
+      assert stats.endpoints == 200
+      assert stats.last_add_count == 200
+      assert stats.arena_bytes == 256 * stats.bytes_per_endpoint
+      assert stats.slot_bytes < stats.bytes_per_endpoint
+
+      assert {:ok, removed} = NIF.nif_remove_bridged_endpoints(ctx, endpoints)
+      assert Enum.all?(removed, &(&1 == :ok))
+      assert {:error, :attribute_not_found} = NIF.nif_get_attribute(ctx, 3, 0x0402, 0x0000)
+      assert {:ok, %{endpoints: 0, removed: removed_count}} = NIF.nif_get_bridge_stats(ctx)
+      assert removed_count >= 200
+    end
+
+    test "bridged writes report changes", %{ctx: ctx} do
+      :ok = NIF.nif_configure_bridge(ctx, 4, 2)
+      :ok = NIF.nif_register_callback(ctx)
+
+      {:ok, ep} = NIF.nif_add_bridged_endpoint(ctx, 1, {:contact_sensor, "Door", "ble-7"})
+      assert :ok = NIF.nif_set_attribute(ctx, ep, 0x0045, 0x0000, true)
+      assert_receive {:attribute_changed, ^ep, 0x0045, 0x0000, 0x10, true}
+    end
+
+    test "reports a full arena and bad devices per entry", %{ctx: ctx} do
+      :ok = NIF.nif_configure_bridge(ctx, 2, 2)
+
+      devices = [
+        {:humidity_sensor, "A", "a"},
+        {:toaster, "B", "b"},
+        {:on_off_light, String.duplicate("x", 33), "c"},
+        {:on_off_light, "D", "d"},
+        {:on_off_light, "E", "e"}
+      ]
+
+      assert {:ok, results} = NIF.nif_add_bridged_endpoints(ctx, 1, devices)
+
+      assert [
+               {:ok, 2},
+               {:error, :unknown_device_type},
+               {:error, :invalid_value},
+               {:ok, 3},
+               {:error, :bridge_full}
+             ] = results
+
+      assert {:error, :invalid_args} = NIF.nif_add_bridged_endpoint(ctx, 1, :light)
+      assert {:error, :invalid_endpoint_id} = NIF.nif_add_bridged_endpoint(ctx, 9, hd(devices))
+      assert {:error, :bridge_busy} = NIF.nif_configure_bridge(ctx, 8, 2)
+    end
+
+    test "removed IDs are not reused right away and handles go stale", %{ctx: ctx} do
+      :ok = NIF.nif_configure_bridge(ctx, 2, 2)
+
+      {:ok, 2} = NIF.nif_add_bridged_endpoint(ctx, 1, {:on_off_light, "A", "a"})
+      {:ok, handle} = NIF.nif_resolve_attribute(ctx, 2, 0x0006, 0x0000)
+
+      assert :ok = NIF.nif_remove_bridged_endpoint(ctx, 2)
+      assert {:error, :endpoint_not_found} = NIF.nif_remove_bridged_endpoint(ctx, 2)
+      assert {:error, :stale_handle} = NIF.nif_get_attribute_h(ctx, handle)
+
+      assert {:ok, 3} = NIF.nif_add_bridged_endpoint(ctx, 1, {:on_off_light, "B", "b"})
+      assert {:ok, "B"} = NIF.nif_get_attribute(ctx, 3, 0x0039, 0x0005)
+    end
+
+    test "stopping the server removes bridged endpoints", %{ctx: ctx} do
+      :ok = NIF.nif_configure_bridge(ctx, 2, 2)
+      {:ok, ep} = NIF.nif_add_bridged_endpoint(ctx, 1, {:dimmable_light, "A", "a"})
+
+      :ok = NIF.nif_stop_server(ctx)
+
+      assert {:error, :attribute_not_found} = NIF.nif_get_attribute(ctx, ep, 0x0008, 0x0000)
+      assert {:ok, %{endpoints: 0, capacity: 2}} = NIF.nif_get_bridge_stats(ctx)
+    end
+  end
+
+  describe "report deferral" do
+    setup do
+      {:ok, ctx} = NIF.nif_init()
+
+      on_exit(fn ->
+        :ok = NIF.nif_set_report_intervals(ctx, [])
+        # Stopping also closes transactions a failed test left open
+        :ok = NIF.nif_stop_server(ctx)
+      end)
+
+      %{ctx: ctx}
+    end
+
+    test "a transaction marks its writes once at commit", %{ctx: ctx} do
+      {:ok, on} = NIF.nif_get_attribute(ctx, 1, 0x0006, 0x0000)
+      :ok = NIF.nif_set_attribute(ctx, 1, 0x0008, 0x0000, 16)
+      :ok = NIF.nif_set_attribute(ctx, 1, 0x0300, 0x0007, 320)
+      {:ok, before} = NIF.nif_get_report_stats(ctx)
+
+      assert :ok = NIF.nif_begin_writes(ctx)
+
+      assert {:ok, [:ok, :ok, :ok]} =
+               NIF.nif_set_attributes(ctx, [
+                 {1, 0x0006, 0x0000, not on},
+                 {1, 0x0008, 0x0000, 17},
+                 {1, 0x0008, 0x0000, 18}
+               ])
+
+      assert :ok = NIF.nif_set_attribute(ctx, 1, 0x0300, 0x0007, 321)
+      assert {:ok, 18} = NIF.nif_get_attribute(ctx, 1, 0x0008, 0x0000)
+
+      assert {:ok, %{transactions: 1, pending: pending, deferred: deferred}} =
+               NIF.nif_get_report_stats(ctx)
+
+      assert pending >= 3
+      assert deferred - before.deferred == 4
+
+      assert {:ok, 3} = NIF.nif_commit_writes(ctx)
+      assert {:ok, stats} = NIF.nif_get_report_stats(ctx)
+      assert %{transactions: 0, pending: 0} = stats
+      assert stats.flushes == before.flushes + 1
+      assert stats.flushed == before.flushed + 3
+    end
+
+    test "transactions nest", %{ctx: ctx} do
+      assert :ok = NIF.nif_begin_writes(ctx)
+      assert :ok = NIF.nif_begin_writes(ctx)
+      assert :ok = NIF.nif_set_attribute(ctx, 1, 0x0008, 0x0000, 40)
+      assert :ok = NIF.nif_set_attribute(ctx, 1, 0x0008, 0x0000, 41)
+
+      assert {:ok, 0} = NIF.nif_commit_writes(ctx)
+      assert {:ok, 1} = NIF.nif_commit_writes(ctx)
+      assert {:error, :no_transaction} = NIF.nif_commit_writes(ctx)
+    end
+
+    test "unchanged values are not deferred", %{ctx: ctx} do
+      :ok = NIF.nif_set_attribute(ctx, 1, 0x0008, 0x0000, 60)
+      {:ok, before} = NIF.nif_get_report_stats(ctx)
+
+      :ok = NIF.nif_begin_writes(ctx)
+      :ok = NIF.nif_set_attribute(ctx, 1, 0x0008, 0x0000, 60)
+      assert {:ok, 0} = NIF.nif_commit_writes(ctx)
+
+      assert {:ok, %{deferred: deferred}} = NIF.nif_get_report_stats(ctx)
+      assert deferred == before.deferred
+    end
+
+    test "a minimum interval holds writes until it has passed", %{ctx: ctx} do
+      :ok = NIF.nif_set_attribute(ctx, 1, 0x0300, 0x0007, 199)
+      :ok = NIF.nif_set_attribute(ctx, 1, 0x0300, 0x0008, 1)
+      :ok = NIF.nif_set_report_intervals(ctx, [{0x0300, 100}])
+      {:ok, before} = NIF.nif_get_report_stats(ctx)
+
+      # The first write is marked at once and starts the interval
+      :ok = NIF.nif_set_attribute(ctx, 1, 0x0300, 0x0007, 200)
+      :ok = NIF.nif_set_attribute(ctx, 1, 0x0300, 0x0007, 201)
+      :ok = NIF.nif_set_attribute(ctx, 1, 0x0300, 0x0008, 2)
+
+      assert {:ok, %{pending: 2, deferred: deferred}} = NIF.nif_get_report_stats(ctx)
+      assert deferred - before.deferred == 2
+
+      # Other clusters are not held
+      :ok = NIF.nif_set_attribute(ctx, 1, 0x0008, 0x0000, 90)
+      assert {:ok, %{pending: 2}} = NIF.nif_get_report_stats(ctx)
+
+      Process.sleep(150)
+      assert {:ok, stats} = NIF.nif_get_report_stats(ctx)
+      assert stats.pending == 0
+      assert stats.flushed == before.flushed + 2
+    end
+
+    test "removing intervals marks held writes", %{ctx: ctx} do
+      :ok = NIF.nif_set_attribute(ctx, 1, 0x0300, 0x0007, 299)
+      :ok = NIF.nif_set_report_intervals(ctx, [{0x0300, 60_000}])
+      :ok = NIF.nif_set_attribute(ctx, 1, 0x0300, 0x0007, 300)
+      :ok = NIF.nif_set_attribute(ctx, 1, 0x0300, 0x0007, 301)
+      assert {:ok, %{pending: 1}} = NIF.nif_get_report_stats(ctx)
+
+      :ok = NIF.nif_set_report_intervals(ctx, [])
+      assert {:ok, %{pending: 0}} = NIF.nif_get_report_stats(ctx)
+    end
+
+    test "rejects malformed intervals", %{ctx: ctx} do
+      assert {:error, :invalid_args} = NIF.nif_set_report_intervals(ctx, [{0x0300, 0}])
+      assert {:error, :invalid_args} = NIF.nif_set_report_intervals(ctx, [0x0300])
+      assert {:error, :invalid_args} = NIF.nif_set_report_intervals(ctx, :none)
+    end
+  end
+
+  describe "async operations" do
+    test "set_attribute_async replies with the write result" do
+      {:ok, ctx} = NIF.nif_init()
+      assert {:ok, ref} = NIF.nif_set_attribute_async(ctx, 1, 0x0006, 0x0000, true)
+      assert is_reference(ref)
+      assert_receive {:matter_reply, ^ref, :ok}
+    end
+
+    test "get_attribute_async replies with the value" do
+      {:ok, ctx} = NIF.nif_init()
+      assert {:ok, ref} = NIF.nif_get_attribute_async(ctx, 1, 0x0006, 0x0000)
+      assert_receive {:matter_reply, ^ref, {:ok, _value}}
+    end
+
+    test "async NIFs validate input before queueing" do
+      {:ok, ctx} = NIF.nif_init()
+
+      assert {:error, :invalid_args} = NIF.nif_get_attribute_async(ctx, -1, 0x0006, 0x0000)
+
+      assert {:error, :invalid_endpoint_id} =
+               NIF.nif_set_attribute_async(ctx, 0x10000, 0x0006, 0x0000, 1)
+
+      assert {:error, :invalid_context} = NIF.nif_get_attribute_async(make_ref(), 1, 6, 0)
+      refute_received {:matter_reply, _, _}
+    end
+
+    test "wifi results can be queued" do
+      {:ok, ctx} = NIF.nif_init()
+      assert {:ok, connect_ref} = NIF.nif_wifi_connect_result_async(ctx, 0)
+      assert {:ok, scan_ref} = NIF.nif_wifi_scan_result_async(ctx, 1)
+      assert_receive {:matter_reply, ^connect_ref, :ok}
+      assert_receive {:matter_reply, ^scan_ref, :ok}
+    end
+  end
+
+  describe "event queue" do
+    test "configure, report stats and disable" do
+      {:ok, ctx} = NIF.nif_init()
+
+      assert :ok = NIF.nif_configure_event_queue(ctx, 100, 16, 5)
+
+      assert {:ok, stats} = NIF.nif_get_event_queue_stats(ctx)
+      assert stats.enabled == true
+      # Capacity is rounded up to a power of two
+      assert stats.capacity == 128
+      assert stats.depth == 0
+      assert stats.overflow == 0
+      assert stats.dropped == 0
+
+      assert :ok = NIF.nif_configure_event_queue(ctx, 0, 0, 0)
+      assert {:ok, %{enabled: false, capacity: 0}} = NIF.nif_get_event_queue_stats(ctx)
+    end
+
+    test "rejects invalid configuration" do
+      {:ok, ctx} = NIF.nif_init()
+
+      assert {:error, :invalid_args} = NIF.nif_configure_event_queue(ctx, 64, 0, 5)
+      assert {:error, :invalid_args} = NIF.nif_configure_event_queue(ctx, 64, 128, 5)
+      assert {:error, :invalid_args} = NIF.nif_configure_event_queue(ctx, 64, 16, 0)
+      assert {:error, :invalid_args} = NIF.nif_configure_event_queue(ctx, -1, 16, 5)
+      assert {:ok, %{enabled: false}} = NIF.nif_get_event_queue_stats(ctx)
+    end
+
+    test "delivers stub writes in batches" do
+      {:ok, ctx} = NIF.nif_init()
+      :ok = NIF.nif_register_callback(ctx)
+      :ok = NIF.nif_configure_event_queue(ctx, 64, 16, 5)
+
+      {:ok, hue} = NIF.nif_get_attribute(ctx, 1, 0x0300, 0x0000)
+      :ok = NIF.nif_set_attribute(ctx, 1, 0x0300, 0x0000, rem(hue + 1, 256))
+
+      assert_receive {:attribute_changes, [{1, 0x0300, 0x0000, 0x20, _value}]}
+      assert {:ok, %{pushed: 1}} = NIF.nif_get_event_queue_stats(ctx)
+
+      :ok = NIF.nif_configure_event_queue(ctx, 0, 0, 0)
+    end
+
+    test "delivers values longer than a record out of line" do
+      {:ok, ctx} = NIF.nif_init()
+      :ok = NIF.nif_register_callback(ctx)
+      :ok = NIF.nif_configure_event_queue(ctx, 64, 16, 5)
+
+      label = "Living room ceiling light"
+      :ok = NIF.nif_set_attribute(ctx, 0, 0x0028, 0x0005, label)
+      assert_receive {:attribute_changes, [{0, 0x0028, 0x0005, 0x42, ^label}]}
+
+      :ok = NIF.nif_set_attribute(ctx, 0, 0x0028, 0x0005, "")
+      assert_receive {:attribute_changes, [{0, 0x0028, 0x0005, 0x42, ""}]}
+      :ok = NIF.nif_configure_event_queue(ctx, 0, 0, 0)
+    end
+  end
+
+  describe "log ring" do
+    setup do
+      {:ok, ctx} = NIF.nif_init()
+      :ok = NIF.nif_set_log_levels(ctx, :info, [])
+
+      on_exit(fn ->
+        NIF.nif_configure_log(ctx, nil, 0, 0, 0)
+        NIF.nif_set_log_levels(ctx, :info, [])
+        NIF.nif_set_log_crash_file(ctx, nil)
+      end)
+
+      %{ctx: ctx}
+    end
+
+    test "configure, report stats and disable", %{ctx: ctx} do
+      assert :ok = NIF.nif_configure_log(ctx, nil, 100, 16, 5)
+
+      assert {:ok, stats} = NIF.nif_get_log_stats(ctx)
+      assert stats.enabled == true
+      # Capacity is rounded up to a power of two
+      assert stats.capacity == 128
+      assert stats.depth == 0
+      assert stats.dropped == 0
+
+      # 128 slots of 256-byte records
+      assert {:ok, %{nif: %{log_ring_bytes: 32_768}}} = NIF.nif_get_memory_stats(ctx)
+
+      assert :ok = NIF.nif_configure_log(ctx, nil, 0, 0, 0)
+      assert {:ok, %{enabled: false, capacity: 0}} = NIF.nif_get_log_stats(ctx)
+    end
+
+    test "delivers the NIF's messages in batches", %{ctx: ctx} do
+      :ok = NIF.nif_configure_log(ctx, self(), 64, 16, 5)
+      :ok = NIF.nif_start_server(ctx)
+      :ok = NIF.nif_stop_server(ctx)
+
+      assert_receive {:matter_log, [{time_us, :info, "NIF", message} | _]}
+      assert message =~ "Start phase"
+      assert_in_delta time_us, System.os_time(:microsecond), 5_000_000
+
+      assert wait_until(fn ->
+               match?({:ok, %{depth: 0, written: 6, delivered: 6}}, NIF.nif_get_log_stats(ctx))
+             end)
+    end
+
+    test "levels filter records before they are kept", %{ctx: ctx} do
+      :ok = NIF.nif_configure_log(ctx, nil, 64, 16, 5)
+      :ok = NIF.nif_set_log_levels(ctx, :error, [])
+      :ok = NIF.nif_stop_server(ctx)
+      assert {:ok, %{written: 0, filtered: 1}} = NIF.nif_get_log_stats(ctx)
+
+      :ok = NIF.nif_set_log_levels(ctx, :none, [{"NIF", :debug}])
+      :ok = NIF.nif_stop_server(ctx)
+      assert {:ok, %{written: 1, filtered: 1}} = NIF.nif_get_log_stats(ctx)
+    end
+
+    test "a full ring overwrites its oldest records", %{ctx: ctx} do
+      :ok = NIF.nif_configure_log(ctx, nil, 4, 4, 5)
+      for _ <- 1..6, do: :ok = NIF.nif_stop_server(ctx)
+
+      assert {:ok, %{written: 6, depth: 4, dropped: 2}} = NIF.nif_get_log_stats(ctx)
+    end
+
+    test "accepts a crash file and removes it", %{ctx: ctx} do
+      path = Path.join(System.tmp_dir!(), "matterlix_crash_test.log")
+      assert :ok = NIF.nif_set_log_crash_file(ctx, path)
+      assert :ok = NIF.nif_set_log_crash_file(ctx, nil)
+      refute File.exists?(path)
+    end
+
+    test "rejects invalid configuration", %{ctx: ctx} do
+      assert {:error, :invalid_args} = NIF.nif_configure_log(ctx, nil, 64, 0, 5)
+      assert {:error, :invalid_args} = NIF.nif_configure_log(ctx, nil, 64, 128, 5)
+      assert {:error, :invalid_args} = NIF.nif_configure_log(ctx, nil, 64, 16, 0)
+      assert {:error, :invalid_args} = NIF.nif_configure_log(ctx, :self, 64, 16, 5)
+      assert {:ok, %{enabled: false}} = NIF.nif_get_log_stats(ctx)
+
+      assert {:error, :invalid_level} = NIF.nif_set_log_levels(ctx, :warning, [])
+      assert {:error, :invalid_level} = NIF.nif_set_log_levels(ctx, :info, [{"DMG", :verbose}])
+      assert {:error, :invalid_args} = NIF.nif_set_log_levels(ctx, :info, [{"LONGNAME", :debug}])
+      assert {:error, :invalid_args} = NIF.nif_set_log_levels(ctx, :info, [{~c"DMG", :debug}])
+
+      assert {:error, :invalid_args} = NIF.nif_set_log_crash_file(ctx, "")
+      long_path = String.duplicate("a", 300)
+      assert {:error, :invalid_args} = NIF.nif_set_log_crash_file(ctx, long_path)
+    end
+  end
+
+  describe "storage" do
+    setup do
+      {:ok, ctx} = NIF.nif_init()
+      path = Path.join(System.tmp_dir!(), "matterlix_kvs_test.bin")
+      File.rm(path)
+
+      on_exit(fn ->
+        # The next start closes the store
+        NIF.nif_configure_storage(ctx, nil, 5000, nil)
+        NIF.nif_start_server(ctx)
+        NIF.nif_stop_server(ctx)
+        File.rm(path)
+      end)
+
+      %{ctx: ctx, path: path}
+    end
+
+    test "opens the store at the next start", %{ctx: ctx, path: path} do
+      assert {:ok, %{enabled: false}} = NIF.nif_get_storage_stats(ctx)
+      assert :ok = NIF.nif_configure_storage(ctx, path, 1000, nil)
+      assert {:ok, %{enabled: true}} = NIF.nif_get_storage_stats(ctx)
+
+      :ok = NIF.nif_start_server(ctx)
+      :ok = NIF.nif_stop_server(ctx)
+
+      assert {:ok, stats} = NIF.nif_get_storage_stats(ctx)
+      assert stats.open == true
+      assert stats.path == path
+      assert stats.keys == 0
+      assert stats.dirty == false
+    end
+
+    test "loads a store file", %{ctx: ctx, path: path} do
+      entries = [{"f/1/n", <<1, 2, 3>>}, {"g/fidx", <<0>>}]
+
+      body =
+        for {key, value} <- entries, into: <<"VKTM", 1::native-32, 2::native-32>> do
+          <<byte_size(key)::native-16, key::binary, byte_size(value)::native-16, value::binary>>
+        end
+
+      File.write!(path, body <> <<:erlang.crc32(body)::native-32>>)
+
+      :ok = NIF.nif_configure_storage(ctx, path, 1000, ["f/"])
+      :ok = NIF.nif_start_server(ctx)
+      :ok = NIF.nif_stop_server(ctx)
+
+      assert {:ok, %{open: true, keys: 2, bytes: 15}} = NIF.nif_get_storage_stats(ctx)
+    end
+
+    test "a corrupt store file fails the start", %{ctx: ctx, path: path} do
+      File.write!(path, "not a store")
+      :ok = NIF.nif_configure_storage(ctx, path, 1000, nil)
+
+      assert {:error, :storage_load_failed} = NIF.nif_start_server(ctx)
+      assert {:ok, %{open: false}} = NIF.nif_get_storage_stats(ctx)
+      assert File.read!(path) == "not a store"
+    end
+
+    test "rejects invalid configuration", %{ctx: ctx, path: path} do
+      assert {:error, :invalid_args} = NIF.nif_configure_storage(ctx, "", 1000, nil)
+      assert {:error, :invalid_args} = NIF.nif_configure_storage(ctx, "bad\0path", 1000, nil)
+      assert {:error, :invalid_args} = NIF.nif_configure_storage(ctx, path, 99, nil)
+      assert {:error, :invalid_args} = NIF.nif_configure_storage(ctx, path, 3_600_001, nil)
+      assert {:error, :invalid_args} = NIF.nif_configure_storage(ctx, path, 1000, [""])
+      assert {:error, :invalid_args} = NIF.nif_configure_storage(ctx, path, 1000, [:f])
+      assert {:error, :invalid_args} = NIF.nif_configure_storage(ctx, path, 1000, "f/")
+      assert {:ok, %{enabled: false}} = NIF.nif_get_storage_stats(ctx)
+    end
+  end
+
+  describe "ota" do
+    setup do
+      {:ok, ctx} = NIF.nif_init()
+      on_exit(fn -> NIF.nif_configure_ota(ctx, nil, nil, 0) end)
+      %{ctx: ctx}
+    end
+
+    test "configures the sink and reports stats", %{ctx: ctx} do
+      assert {:ok, %{enabled: false, state: :idle}} = NIF.nif_get_ota_stats(ctx)
+
+      assert :ok = NIF.nif_configure_ota(ctx, self(), nil, 0)
+      assert {:ok, stats} = NIF.nif_get_ota_stats(ctx)
+      assert stats.enabled == true
+      assert stats.sink == :process
+      assert stats.total == nil
+      assert stats.downloads == 0
+
+      path = Path.join(System.tmp_dir!(), "matterlix_ota_test.bin")
+      assert :ok = NIF.nif_configure_ota(ctx, self(), path, 4096)
+      assert {:ok, %{sink: :file, resume_offset: 4096}} = NIF.nif_get_ota_stats(ctx)
+
+      # No buffer until a block has to wait for a FIFO
+      assert {:ok, %{nif: %{ota_buffer_bytes: 0}}} = NIF.nif_get_memory_stats(ctx)
+
+      assert :ok = NIF.nif_configure_ota(ctx, nil, nil, 0)
+      assert {:ok, %{enabled: false}} = NIF.nif_get_ota_stats(ctx)
+    end
+
+    test "acks need a block waiting", %{ctx: ctx} do
+      :ok = NIF.nif_configure_ota(ctx, self(), nil, 0)
+      assert {:error, :no_block} = NIF.nif_ota_ack(ctx, 1024)
+      assert {:error, :invalid_args} = NIF.nif_ota_ack(ctx, -1)
+    end
+
+    test "rejects invalid configuration", %{ctx: ctx} do
+      assert {:error, :invalid_args} = NIF.nif_configure_ota(ctx, :self, nil, 0)
+      assert {:error, :invalid_args} = NIF.nif_configure_ota(ctx, nil, "/tmp/ota.bin", 0)
+      assert {:error, :invalid_args} = NIF.nif_configure_ota(ctx, self(), "", 0)
+      assert {:error, :invalid_args} = NIF.nif_configure_ota(ctx, self(), "bad\0path", 0)
+      assert {:error, :invalid_args} = NIF.nif_configure_ota(ctx, self(), nil, -1)
+      assert {:ok, %{enabled: false}} = NIF.nif_get_ota_stats(ctx)
+    end
+  end
+
+  describe "hot upgrade" do
+    test "a new module version takes over the server, listener and subscribers" do
+      {:ok, ctx} = NIF.nif_init()
+      :ok = NIF.nif_register_callback(ctx)
+      ui = relay(:ui)
+      :ok = NIF.nif_subscribe(ctx, ui, nil)
+      :ok = NIF.nif_start_server(ctx)
+      {:ok, %{upgrades: upgrades}} = NIF.nif_get_info(ctx)
+
+      reload_nif()
+
+      assert {:ok, %{server_started: true, is_owner: true, upgrades: upgraded}} =
+               NIF.nif_get_info(ctx)
+
+      assert upgraded == upgrades + 1
+      assert {:ok, [^ui]} = NIF.nif_get_subscribers(ctx)
+
+      {:ok, saturation} = NIF.nif_get_attribute(ctx, 1, 0x0300, 0x0001)
+      value = rem(saturation + 1, 256)
+      :ok = NIF.nif_set_attribute(ctx, 1, 0x0300, 0x0001, value)
+      assert_receive {:attribute_changed, 1, 0x0300, 0x0001, 0x20, ^value}
+      assert_receive {:ui, {:attribute_changed, 1, 0x0300, 0x0001, 0x20, ^value}}
+
+      :ok = NIF.nif_unsubscribe(ctx, ui)
+      :ok = NIF.nif_stop_server(ctx)
+    end
+
+    test "a detached server is taken over by the next context" do
+      {:ok, ctx} = NIF.nif_init()
+      :ok = NIF.nif_register_callback(ctx)
+      :ok = NIF.nif_start_server(ctx)
+      :ok = NIF.nif_detach(ctx)
+      assert {:ok, %{is_owner: false, server_started: true}} = NIF.nif_get_info(ctx)
+
+      {:ok, next} = NIF.nif_init()
+      assert {:ok, %{is_owner: true, server_started: true}} = NIF.nif_get_info(next)
+
+      :ok = NIF.nif_stop_server(next)
+      assert {:ok, %{server_started: false}} = NIF.nif_get_info(ctx)
+    end
+  end
+
+  describe "coalescing" do
+    test "accepts rules and an empty list" do
+      {:ok, ctx} = NIF.nif_init()
+
+      rules = [{{:_, 0x0008, 0x0000}, 100}, {{1, 0x0300, :_}, 50}]
+      assert :ok = NIF.nif_set_coalescing(ctx, rules)
+      assert :ok = NIF.nif_set_coalescing(ctx, [])
+    end
+
+    test "rejects malformed rules" do
+      {:ok, ctx} = NIF.nif_init()
+
+      assert {:error, :invalid_args} = NIF.nif_set_coalescing(ctx, [{{1, 8, 0}, 0}])
+      assert {:error, :invalid_args} = NIF.nif_set_coalescing(ctx, [{{1, 8}, 100}])
+      assert {:error, :invalid_args} = NIF.nif_set_coalescing(ctx, [{1, 8, 0}])
+      assert {:error, :invalid_args} = NIF.nif_set_coalescing(ctx, nil)
+    end
+  end
+
+  describe "change filter" do
+    test "accepts allow and deny patterns with wildcards" do
+      {:ok, ctx} = NIF.nif_init()
+
+      assert :ok = NIF.nif_set_change_filter(ctx, {:allow, [{1, 0x0006, :_}, {:_, 0x0008, 0}]})
+      assert :ok = NIF.nif_set_change_filter(ctx, {:deny, [{:_, :_, 0xFFFC}]})
+      assert :ok = NIF.nif_set_change_filter(ctx, {:allow, []})
+      assert :ok = NIF.nif_set_change_filter(ctx, nil)
+    end
+
+    test "filtered stub writes are not reported" do
+      {:ok, ctx} = NIF.nif_init()
+      :ok = NIF.nif_register_callback(ctx)
+      :ok = NIF.nif_set_change_filter(ctx, {:deny, [{1, 0x0300, :_}]})
+
+      {:ok, saturation} = NIF.nif_get_attribute(ctx, 1, 0x0300, 0x0001)
+      :ok = NIF.nif_set_attribute(ctx, 1, 0x0300, 0x0001, rem(saturation + 1, 256))
+      refute_receive {:attribute_changed, 1, 0x0300, _, _, _}, 50
+
+      :ok = NIF.nif_set_change_filter(ctx, nil)
+    end
+
+    test "rejects malformed filters" do
+      {:ok, ctx} = NIF.nif_init()
+
+      assert {:error, :invalid_args} = NIF.nif_set_change_filter(ctx, {:only, []})
+      assert {:error, :invalid_args} = NIF.nif_set_change_filter(ctx, {:allow, [{1, 6}]})
+      assert {:error, :invalid_args} = NIF.nif_set_change_filter(ctx, {:allow, [{70_000, 6, 0}]})
+      assert {:error, :invalid_args} = NIF.nif_set_change_filter(ctx, {:deny, [{1, :any, 0}]})
+      assert {:error, :invalid_args} = NIF.nif_set_change_filter(ctx, {:deny, :all})
+    end
+  end
+
+  describe "subscribers" do
+    setup do
+      on_exit(fn ->
+        {:ok, ctx} = NIF.nif_init()
+        {:ok, pids} = NIF.nif_get_subscribers(ctx)
+        Enum.each(pids, &NIF.nif_unsubscribe(ctx, &1))
+        :ok = NIF.nif_set_change_filter(ctx, nil)
+      end)
+    end
+
+    test "every subscriber receives the change the listener does" do
+      {:ok, ctx} = NIF.nif_init()
+      :ok = NIF.nif_register_callback(ctx)
+      ui = relay(:ui)
+      cloud = relay(:cloud)
+      :ok = NIF.nif_subscribe(ctx, ui, nil)
+      :ok = NIF.nif_subscribe(ctx, cloud, nil)
+      assert {:ok, [^ui, ^cloud]} = NIF.nif_get_subscribers(ctx)
+
+      {:ok, before} = NIF.nif_get_stats(ctx)
+      {:ok, saturation} = NIF.nif_get_attribute(ctx, 1, 0x0300, 0x0001)
+      value = rem(saturation + 1, 256)
+      :ok = NIF.nif_set_attribute(ctx, 1, 0x0300, 0x0001, value)
+
+      assert_receive {:attribute_changed, 1, 0x0300, 0x0001, 0x20, ^value}
+      assert_receive {:ui, {:attribute_changed, 1, 0x0300, 0x0001, 0x20, ^value}}
+      assert_receive {:cloud, {:attribute_changed, 1, 0x0300, 0x0001, 0x20, ^value}}
+
+      {:ok, stats} = NIF.nif_get_stats(ctx)
+      assert stats.attribute_changes.fanned_out - before.attribute_changes.fanned_out == 2
+    end
+
+    test "subscriber filters are separate from the change filter" do
+      {:ok, ctx} = NIF.nif_init()
+      :ok = NIF.nif_register_callback(ctx)
+      :ok = NIF.nif_set_change_filter(ctx, {:deny, [{1, 0x0300, :_}]})
+      color = relay(:color)
+      on_off = relay(:on_off)
+      :ok = NIF.nif_subscribe(ctx, color, {:allow, [{:_, 0x0300, :_}]})
+      :ok = NIF.nif_subscribe(ctx, on_off, {:allow, [{:_, 0x0006, :_}]})
+
+      {:ok, saturation} = NIF.nif_get_attribute(ctx, 1, 0x0300, 0x0001)
+      :ok = NIF.nif_set_attribute(ctx, 1, 0x0300, 0x0001, rem(saturation + 1, 256))
+
+      assert_receive {:color, {:attribute_changed, 1, 0x0300, 0x0001, _, _}}
+      refute_receive {:attribute_changed, 1, 0x0300, _, _, _}, 50
+      refute_receive {:on_off, _}, 50
+    end
+
+    test "queued batches fan out with each subscriber's records" do
+      {:ok, ctx} = NIF.nif_init()
+      :ok = NIF.nif_register_callback(ctx)
+      :ok = NIF.nif_configure_event_queue(ctx, 64, 16, 5)
+      hue_only = relay(:hue_only)
+      :ok = NIF.nif_subscribe(ctx, hue_only, {:allow, [{1, 0x0300, 0x0000}]})
+
+      {:ok, hue} = NIF.nif_get_attribute(ctx, 1, 0x0300, 0x0000)
+      {:ok, saturation} = NIF.nif_get_attribute(ctx, 1, 0x0300, 0x0001)
+
+      {:ok, [:ok, :ok]} =
+        NIF.nif_set_attributes(ctx, [
+          {1, 0x0300, 0x0000, rem(hue + 1, 256)},
+          {1, 0x0300, 0x0001, rem(saturation + 1, 256)}
+        ])
+
+      assert_receive {:attribute_changes, [{1, 0x0300, 0x0000, _, _} | _]}
+      assert_receive {:hue_only, {:attribute_changes, [{1, 0x0300, 0x0000, _, _}]}}
+      refute_receive {:hue_only, {:attribute_changes, [{1, 0x0300, 0x0001, _, _} | _]}}, 50
+
+      :ok = NIF.nif_configure_event_queue(ctx, 0, 0, 0)
+    end
+
+    test "a subscription ends when its process exits" do
+      {:ok, ctx} = NIF.nif_init()
+      subscriber = spawn(fn -> Process.sleep(:infinity) end)
+      :ok = NIF.nif_subscribe(ctx, subscriber, nil)
+
+      ref = Process.monitor(subscriber)
+      Process.exit(subscriber, :kill)
+      assert_receive {:DOWN, ^ref, :process, _, :killed}
+
+      assert wait_until(fn -> NIF.nif_get_subscribers(ctx) == {:ok, []} end)
+      assert {:error, :noproc} = NIF.nif_subscribe(ctx, subscriber, nil)
+    end
+
+    test "resubscribing replaces the filter and unsubscribing stops delivery" do
+      {:ok, ctx} = NIF.nif_init()
+      subscriber = relay(:sub)
+      :ok = NIF.nif_subscribe(ctx, subscriber, {:allow, [{:_, 0x0006, :_}]})
+      :ok = NIF.nif_subscribe(ctx, subscriber, nil)
+      assert {:ok, [^subscriber]} = NIF.nif_get_subscribers(ctx)
+
+      {:ok, saturation} = NIF.nif_get_attribute(ctx, 1, 0x0300, 0x0001)
+      :ok = NIF.nif_set_attribute(ctx, 1, 0x0300, 0x0001, rem(saturation + 1, 256))
+      assert_receive {:sub, {:attribute_changed, 1, 0x0300, 0x0001, _, _}}
+
+      assert :ok = NIF.nif_unsubscribe(ctx, subscriber)
+      assert {:error, :not_subscribed} = NIF.nif_unsubscribe(ctx, subscriber)
+
+      :ok = NIF.nif_set_attribute(ctx, 1, 0x0300, 0x0001, saturation)
+      refute_receive {:sub, _}, 50
+    end
+
+    test "rejects bad arguments and more than 32 subscribers" do
+      {:ok, ctx} = NIF.nif_init()
+
+      assert {:error, :invalid_args} = NIF.nif_subscribe(ctx, self(), {:only, []})
+      assert {:error, :invalid_args} = NIF.nif_subscribe(ctx, :not_a_pid, nil)
+
+      for i <- 1..32, do: :ok = NIF.nif_subscribe(ctx, relay(i), nil)
+      assert {:error, :too_many_subscribers} = NIF.nif_subscribe(ctx, relay(33), nil)
+    end
+  end
+
   describe "wifi callbacks" do
     test "wifi_connect_result succeeds" do
       {:ok, ctx} = NIF.nif_init()
@@ -155,6 +1112,30 @@ defmodule Matterlix.Matter.NIFTest do
       {:ok, ctx} = NIF.nif_init()
       assert :ok = NIF.nif_wifi_scan_result(ctx, 0)
     end
+
+    test "wifi_scan_result accepts packed networks" do
+      {:ok, ctx} = NIF.nif_init()
+      record = <<0x08, 0, 6::16-big, -50::signed-8, 1, 2, 3, 4, 5, 6, 4, "Home">>
+      assert :ok = NIF.nif_wifi_scan_result(ctx, 0, record <> record)
+      assert {:ok, ref} = NIF.nif_wifi_scan_result_async(ctx, 0, record)
+      assert_receive {:matter_reply, ^ref, :ok}
+    end
+
+    test "wifi_scan_result rejects malformed or oversized batches" do
+      {:ok, ctx} = NIF.nif_init()
+      record = <<0x08, 0, 6::16-big, -50::signed-8, 1, 2, 3, 4, 5, 6, 4, "Home">>
+      truncated = binary_part(record, 0, 15)
+      long_ssid = <<0x01, 0, 1::16-big, -70, 0::48, 33, :binary.copy("x", 33)::binary>>
+      too_many = :binary.copy(record, 65)
+
+      for results <- [truncated, long_ssid, too_many] do
+        assert {:error, :invalid_args} = NIF.nif_wifi_scan_result(ctx, 0, results)
+      end
+
+      assert {:error, :invalid_args} = NIF.nif_wifi_scan_result_async(ctx, 0, <<1, 2, 3>>)
+      assert {:error, :invalid_args} = NIF.nif_wifi_scan_result(ctx, 0, :not_a_binary)
+      refute_received {:matter_reply, _, _}
+    end
   end
 
   describe "error handling" do
@@ -164,8 +1145,28 @@ defmodule Matterlix.Matter.NIFTest do
 
       assert {:error, :invalid_context} = NIF.nif_get_info(fake_ref)
       assert {:error, :invalid_context} = NIF.nif_start_server(fake_ref)
+      assert {:error, :invalid_context} = NIF.nif_start_server_async(fake_ref)
+      assert {:error, :invalid_context} = NIF.nif_get_timings(fake_ref)
+      assert {:error, :invalid_context} = NIF.nif_get_stats(fake_ref)
+      assert {:error, :invalid_context} = NIF.nif_get_memory_stats(fake_ref)
       assert {:error, :invalid_context} = NIF.nif_stop_server(fake_ref)
       assert {:error, :invalid_context} = NIF.nif_register_callback(fake_ref)
+      assert {:error, :invalid_context} = NIF.nif_detach(fake_ref)
+      assert {:error, :invalid_context} = NIF.nif_set_attributes(fake_ref, [])
+      assert {:error, :invalid_context} = NIF.nif_get_event_queue_stats(fake_ref)
+      assert {:error, :invalid_context} = NIF.nif_configure_bridge(fake_ref, 1, 2)
+      assert {:error, :invalid_context} = NIF.nif_get_bridge_stats(fake_ref)
+      assert {:error, :invalid_context} = NIF.nif_begin_writes(fake_ref)
+      assert {:error, :invalid_context} = NIF.nif_get_report_stats(fake_ref)
+      assert {:error, :invalid_context} = NIF.nif_subscribe(fake_ref, self(), nil)
+      assert {:error, :invalid_context} = NIF.nif_get_subscribers(fake_ref)
+      assert {:error, :invalid_context} = NIF.nif_configure_log(fake_ref, nil, 0, 0, 0)
+      assert {:error, :invalid_context} = NIF.nif_get_log_stats(fake_ref)
+      assert {:error, :invalid_context} = NIF.nif_configure_storage(fake_ref, nil, 5000, nil)
+      assert {:error, :invalid_context} = NIF.nif_get_storage_stats(fake_ref)
+      assert {:error, :invalid_context} = NIF.nif_configure_ota(fake_ref, nil, nil, 0)
+      assert {:error, :invalid_context} = NIF.nif_ota_ack(fake_ref, 0)
+      assert {:error, :invalid_context} = NIF.nif_get_ota_stats(fake_ref)
     end
 
     test "not initialized context returns error" do
@@ -173,4 +1174,37 @@ defmodule Matterlix.Matter.NIFTest do
       # Skip for now - covered by integration tests
     end
   end
+
+  # A process forwarding every message it receives to the test, tagged
+  # Load the module again and purge the old version, which unloads its
+  # instance of the library, as a release upgrade does
+  defp reload_nif do
+    {module, binary, file} = :code.get_object_code(NIF)
+    :code.purge(NIF)
+    {:module, NIF} = :code.load_binary(module, file, binary)
+    :code.purge(NIF)
+  end
+
+  defp relay(tag) do
+    test = self()
+    spawn_link(fn -> relay_loop(test, tag) end)
+  end
+
+  defp relay_loop(test, tag) do
+    receive do
+      message ->
+        send(test, {tag, message})
+        relay_loop(test, tag)
+    end
+  end
+
+  defp wait_until(fun, attempts \\ 50) do
+    cond do
+      fun.() -> true
+      attempts == 0 -> false
+      true ->
+        Process.sleep(10)
+        wait_until(fun, attempts - 1)
+    end
+  end
 end